@@ -0,0 +1,29 @@
+#ifndef LLVMC_IATTRS_H_
+#define LLVMC_IATTRS_H_
+#include <unordered_set>
+#include "llvm/IR/Module.h"
+
+namespace llvmc::attrs {
+
+    enum class Memory : unsigned {
+        None, Read, Any
+    };
+
+    class Inferer {
+
+        using SCC = std::unordered_set<llvm::Function const*>;
+
+        bool internalize_;
+
+        static bool is_local(llvm::Value const*);
+        static Memory get_memory(llvm::Function const&, SCC const&);
+        static bool will_return(llvm::Function&, bool);
+        void infer(std::vector<llvm::Function*> const&) const;
+
+    public:
+
+        Inferer(bool = true) noexcept;
+        void run(llvm::Module&) const;
+    };
+}
+#endif
\ No newline at end of file
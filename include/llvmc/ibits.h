@@ -0,0 +1,31 @@
+#ifndef LLVMC_IBITS_H_
+#define LLVMC_IBITS_H_
+#include <optional>
+#include "llvm/IR/Module.h"
+#include "llvm/IR/IRBuilder.h"
+
+namespace llvmc::bits {
+
+    enum class Kind : unsigned {
+        PopCount, FindFirst, Clear
+    };
+
+    class Routine {
+
+        static constexpr inline uint64_t word_bits_ = 64;
+
+        Kind kind_;
+
+        static llvm::Value* emit_words(llvm::IRBuilder<>&, llvm::Function&);
+        static void emit_popcount(llvm::Function&);
+        static void emit_findfirst(llvm::Function&);
+        static void emit_clear(llvm::Function&);
+
+    public:
+
+        Routine(Kind) noexcept;
+        static std::optional<Kind> get_kind(std::string const&);
+        llvm::Function* get(llvm::Module&) const;
+    };
+}
+#endif
\ No newline at end of file
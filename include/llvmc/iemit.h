@@ -0,0 +1,31 @@
+#ifndef LLVMC_IEMIT_H_
+#define LLVMC_IEMIT_H_
+#include <llvmc/iopt.h>
+#include "llvm/Target/TargetMachine.h"
+
+namespace llvmc::emit {
+
+    enum class Kind : unsigned {
+        LL, BC, ASM, OBJ, EXE
+    };
+
+    class Emitter {
+
+        Kind kind_;
+        std::string path_;
+        llvm::TargetMachine* machine_;
+
+        bool emit_file(llvm::Module&, std::string const&, Kind) const;
+        bool link(std::string const&) const;
+
+    public:
+
+        Emitter(Kind, std::string, llvm::TargetMachine*) noexcept;
+        bool run(llvm::Module&) const;
+
+        static std::unique_ptr<llvm::TargetMachine>
+            create_machine(opt::Level);
+        static std::string get_extension(Kind);
+    };
+}
+#endif
\ No newline at end of file
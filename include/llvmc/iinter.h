@@ -1,7 +1,13 @@
 #ifndef LLVMC_IINTER_H_
 #define LLVMC_IINTER_H_
 #include <llvmc/ilex.h>
+#include <llvmc/ireduce.h>
+#include <llvmc/ilinalg.h>
+#include <llvmc/isort.h>
+#include <llvmc/ibits.h>
+#include <unordered_map>
 #include "llvm/IR/Value.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/ADT/SmallVector.h"
 
 namespace llvmc::inter {
@@ -10,6 +16,7 @@ namespace llvmc::inter {
     using IndexList = llvm::SmallVector<uint64_t, 8>;
     using ValList = llvm::SmallVector<llvm::Value*, 8>; 
     using ArgList = std::vector<std::unique_ptr<lexer::Token>>;
+    using TypeList = llvm::SmallVector<llvm::Type*, 8>;
 
     class Node {
 
@@ -21,9 +28,25 @@ namespace llvmc::inter {
 
     class Expr : public Node {
 
+    protected:
+
+        static inline std::unordered_map<Expr const*, llvm::Value*> lanes_{};
+
     public:
 
         Expr(std::unique_ptr<lexer::Token>) noexcept;
+        virtual bool is_integral() const;
+        virtual bool has_array() const;
+        virtual bool is_indirect() const;
+        virtual llvm::Value* emit_lane(llvm::Value*);
+
+        static llvm::Type* scalar_type(bool);
+        static llvm::Value* to_double(llvm::Value*);
+        static llvm::Value* to_integer(llvm::Value*);
+        static llvm::Value* to_index(llvm::Value*);
+        static llvm::Value* to_cond(llvm::Value*);
+        static llvm::Value* from_elem(llvm::Value*);
+        static llvm::Value* to_elem(llvm::Value*, llvm::Type*);
 
         const std::unique_ptr<const lexer::Token> op_;
     };
@@ -33,15 +56,25 @@ namespace llvmc::inter {
     class Id : public Expr {
 
         llvm::Value* var_;
+        bool integral_{ true };
+        std::vector<Expr const*> defs_;
+
+        static inline std::vector<Id*> scope_{};
 
     protected:
     
         Id(std::unique_ptr<lexer::Token>, llvm::Value*);
+        void set_val(llvm::Value*);
 
     public:
 
         static std::shared_ptr<Id> 
             get_id(std::unique_ptr<lexer::Token>);
+        static llvm::AllocaInst* emit_alloca(llvm::Type*);
+        static void infer();
+        void add_def(Expr const*);
+        void set_integral(bool);
+        bool is_integral() const override;
         llvm::Value* get_val() const;
         llvm::Value* compile() override;
     };
@@ -54,12 +87,19 @@ namespace llvmc::inter {
         virtual llvm::Align get_align() const = 0;
 
         static inline bool is_array(Expr const*);
+        static llvm::Type* get_storage(llvm::Type*);
+        static llvm::Value* emit_word(llvm::Value*, llvm::Value*, llvm::Value*&);
         static inline const uint64_t kByteSize = 8;
+        static inline const uint64_t kStackSize = 1 << 14;
+        static inline const uint64_t kCacheLine = 64;
+        static inline const uint64_t kWordBits = 64;
     };
 
     class Array : public Id, public IArray {
 
         llvm::Align align_;
+        unsigned writes_{ 0 };
+        llvm::Type* table_{ nullptr };
 
     protected:
 
@@ -69,10 +109,80 @@ namespace llvmc::inter {
     public:
 
         static std::shared_ptr<Array> 
-            get_array(std::unique_ptr<lexer::Token>, IndexList);
+            get_array(std::unique_ptr<lexer::Token>, IndexList,
+                llvm::Type* = nullptr);
         llvm::Value* compile() override;
         llvm::Type* get_type() const override;
         llvm::Align get_align() const override;
+        virtual llvm::Type* get_elem() const;
+        virtual size_t get_rank() const;
+        virtual llvm::Value* get_data();
+        virtual void get_dims(ValList&) const;
+        virtual llvm::Value* emit_element(ValList);
+        void add_write();
+        bool is_readonly() const;
+        void set_constant(llvm::Constant*, llvm::Type*);
+    };
+
+    class ArrayRef : public Array {
+
+        ValList dims_;
+        llvm::Type* elem_;
+
+    protected:
+
+        ArrayRef(std::unique_ptr<lexer::Token>,
+            llvm::Value*, ValList, llvm::Type*);
+        void bind(llvm::Value*, ValList);
+
+    public:
+
+        static std::shared_ptr<ArrayRef> get_ref(std::unique_ptr<lexer::Token>,
+            llvm::Value*, ValList, llvm::Type*);
+        llvm::Type* get_type() const override;
+        llvm::Type* get_elem() const override;
+        size_t get_rank() const override;
+        llvm::Value* get_data() override;
+        void get_dims(ValList&) const override;
+        llvm::Value* emit_offset(ValList);
+        llvm::Value* emit_element(ValList) override;
+    };
+
+    class DynArray : public ArrayRef {
+
+        static inline std::vector<std::pair<llvm::Value*, llvm::Function*>> slots_{};
+        static inline std::vector<std::pair<llvm::BranchInst*, bool>> scopes_{};
+
+    protected:
+
+        DynArray(std::unique_ptr<lexer::Token>, llvm::Type*);
+        llvm::Value* emit_bytes(ValList const&) const;
+        llvm::AllocaInst* emit_slot(llvm::Function*) const;
+
+    public:
+
+        static std::shared_ptr<DynArray>
+            get_dyn(std::unique_ptr<lexer::Token>, llvm::Type* = nullptr);
+        static void emit_free();
+        static void enter_scope(llvm::BranchInst*);
+        static void leave_scope();
+        virtual llvm::Value* emit_alloc(ValList);
+    };
+
+    class MappedArray : public DynArray {
+
+        std::string path_;
+        bool shared_;
+        bool random_{ false };
+
+        MappedArray(std::unique_ptr<lexer::Token>, llvm::Type*, std::string, bool);
+
+    public:
+
+        static std::shared_ptr<MappedArray>
+            get_mapped(std::unique_ptr<lexer::Token>, llvm::Type*, std::string, bool);
+        void set_random();
+        llvm::Value* emit_alloc(ValList) override;
     };
 
     class Op : public Expr {
@@ -84,12 +194,21 @@ namespace llvmc::inter {
 
     class Arith : public Op {
 
+        static constexpr inline double kMaxStep = 1 << 16;
+
         std::unique_ptr<Expr> lhs_, rhs_;
 
+        static bool is_step(Expr const*);
+        llvm::Value* emit(llvm::Value*, llvm::Value*, bool) const;
+
     public:
 
         Arith(std::unique_ptr<lexer::Token>, 
             std::unique_ptr<Expr>, std::unique_ptr<Expr>) noexcept;
+        bool is_integral() const override;
+        bool has_array() const override;
+        bool is_indirect() const override;
+        llvm::Value* emit_lane(llvm::Value*) override;
         llvm::Value* compile() override;
     };
 
@@ -97,10 +216,16 @@ namespace llvmc::inter {
 
         std::unique_ptr<Expr> exp_;
 
+        llvm::Value* emit(llvm::Value*) const;
+
     public:
 
         Unary(std::unique_ptr<lexer::Token>, 
             std::unique_ptr<Expr>) noexcept;
+        bool is_integral() const override;
+        bool has_array() const override;
+        bool is_indirect() const override;
+        llvm::Value* emit_lane(llvm::Value*) override;
         llvm::Value* compile() override;
     };
 
@@ -108,10 +233,15 @@ namespace llvmc::inter {
 
         std::shared_ptr<Id> arr_;
         ArrList args_;
+        llvm::Value* bit_;
 
     public:
 
         Access(std::shared_ptr<Id>, ArrList);
+        Array* get_array() const;
+        llvm::Type* get_elem() const;
+        llvm::Value* get_bit() const;
+        bool is_integral() const override;
         llvm::Value* compile() override;
     };
 
@@ -122,6 +252,8 @@ namespace llvmc::inter {
     public:
 
         Load(std::shared_ptr<Expr>) noexcept;
+        bool is_integral() const override;
+        bool is_indirect() const override;
         llvm::Value* compile() override;
     };
 
@@ -132,19 +264,36 @@ namespace llvmc::inter {
     public:
 
         ArrayLoad(std::shared_ptr<Id>) noexcept;
+        Array* get_array() const;
+        llvm::Value* emit_lane(llvm::Value*) override;
         llvm::Value* compile() override;
         llvm::Type* get_type() const override;
         llvm::Align get_align() const override;
     };
 
+    class ArrayAlloc : public Op {
+
+        std::shared_ptr<DynArray> arr_;
+        ArrList dims_;
+
+    public:
+
+        ArrayAlloc(std::shared_ptr<DynArray>, ArrList);
+        llvm::Value* compile() override;
+    };
+
     class Store : public Op {
 
         std::shared_ptr<Expr> acc_;
         std::unique_ptr<Expr> val_;
 
+        llvm::Value* emit_lanes(Array*);
+
     public:
 
-        Store(std::shared_ptr<Expr>, std::unique_ptr<Expr>) noexcept;
+        Store(std::shared_ptr<Expr>, std::unique_ptr<Expr>);
+        static void emit_element(llvm::Value*, llvm::Value*,
+            llvm::Type*, llvm::Value*);
         llvm::Value* compile() override;
     };
 
@@ -153,11 +302,23 @@ namespace llvmc::inter {
         std::string name_;
         ArrList args_;
         unsigned saved_;
+        bool tail_;
         class LineGuard;
 
+        bool emit_args(llvm::Function*, ValList&) const;
+        llvm::Value* emit_reduce(reduce::Kind) const;
+        llvm::Value* emit_sort() const;
+        llvm::Value* emit_linalg(linalg::Kind) const;
+        llvm::Value* emit_read() const;
+        llvm::Value* emit_bits(bits::Kind) const;
+
     public:
 
         Call(std::unique_ptr<lexer::Token>, ArrList);
+        llvm::Function* callee() const;
+        bool is_indirect() const override;
+        void set_tail();
+        bool emit_loop(llvm::BasicBlock*, ValList const&) const;
         llvm::Value* compile() override;
     };
 
@@ -166,18 +327,27 @@ namespace llvmc::inter {
     public:
 
         FConstant(std::unique_ptr<lexer::Token>) noexcept;
+        bool is_integral() const override;
         llvm::Value* compile() override;
     };
 
     class ArrayConstant : public Expr, public IArray {
         
         static inline unsigned cnt_{0};
+        static constexpr inline uint64_t raw_size_ = 1 << 12;
+        static inline std::unordered_map<llvm::Constant*,
+            llvm::Constant*> pool_{};
         llvm::Constant* carr_;
         llvm::Align align_;
 
+        static bool get_bytes(llvm::Constant*, std::string&);
+        llvm::Constant* emit_global() const;
+
     public: 
 
         ArrayConstant(ArrList);
+        ArrayConstant(std::vector<double> const&);
+        void cast_to(llvm::Type*);
         llvm::Value* compile() override;
         llvm::Type* get_type() const override;
         llvm::Align get_align() const override;
@@ -188,6 +358,7 @@ namespace llvmc::inter {
     public:
     
         Logical(std::unique_ptr<lexer::Token>) noexcept;
+        bool is_integral() const override;
     };
 
     class Bool : public Logical {
@@ -195,10 +366,15 @@ namespace llvmc::inter {
         std::unique_ptr<Expr> lhs_;
         std::unique_ptr<Expr> rhs_;
 
+        llvm::Value* emit_short_circuit(bool);
+        llvm::Value* emit(llvm::Value*, llvm::Value*) const;
+
     public:
 
         Bool(std::unique_ptr<lexer::Token>, 
             std::unique_ptr<Expr>, std::unique_ptr<Expr>) noexcept;
+        bool has_array() const override;
+        llvm::Value* emit_lane(llvm::Value*) override;
         llvm::Value* compile() override;
     };
 
@@ -210,6 +386,8 @@ namespace llvmc::inter {
 
         Not(std::unique_ptr<lexer::Token>, 
             std::unique_ptr<Expr>) noexcept;
+        bool has_array() const override;
+        llvm::Value* emit_lane(llvm::Value*) override;
         llvm::Value* compile() override;
     };
 
@@ -219,6 +397,11 @@ namespace llvmc::inter {
 
         static inline Stmt* enclosing_ = nullptr;
         static inline llvm::Value* ret_ = nullptr;
+        static inline llvm::BasicBlock* exit_ = nullptr;
+        static inline std::vector<llvm::BasicBlock*> breaks_{};
+        static inline llvm::BasicBlock* head_ = nullptr;
+        static inline ValList params_{};
+        bool is_terminated() const;
         llvm::BasicBlock* create_bb() const;
         llvm::BasicBlock* emit_bb(
             llvm::BasicBlock* = nullptr) const;
@@ -262,9 +445,12 @@ namespace llvmc::inter {
 
         std::unique_ptr<Stmt> stmt_;
 
+        void promote() const;
+
     public:
 
-        FunStmt(std::unique_ptr<lexer::Token>, ArgList);
+        FunStmt(std::unique_ptr<lexer::Token>, ArgList,
+            IndexList = {}, TypeList = {});
         void init(std::unique_ptr<Stmt>);
         llvm::Value* compile() override;
     }; 
@@ -324,8 +510,6 @@ namespace llvmc::inter {
             llvm::BasicBlock*) const;
         void emit_body(llvm::BasicBlock*) const;
         virtual void emit_head(llvm::Value*) const = 0;
-        void fix_br(llvm::BasicBlock*,
-            llvm::BasicBlock*) const;
 
     public:
 
@@ -0,0 +1,34 @@
+#ifndef LLVMC_IJIT_H_
+#define LLVMC_IJIT_H_
+#include <llvmc/iopt.h>
+#include "llvm/IR/LLVMContext.h"
+
+namespace llvmc::jit {
+
+    class Runner {
+
+        opt::Level level_;
+
+    public:
+
+        Runner(opt::Level) noexcept;
+        int run(std::unique_ptr<llvm::Module>,
+            std::unique_ptr<llvm::LLVMContext>) const;
+    };
+
+    class TieredRunner {
+
+        unsigned threshold_;
+        bool verbose_;
+        class Tiers;
+
+        std::vector<std::string> instrument(llvm::Module&) const;
+
+    public:
+
+        TieredRunner(unsigned, bool = false) noexcept;
+        int run(std::unique_ptr<llvm::Module>,
+            std::unique_ptr<llvm::LLVMContext>) const;
+    };
+}
+#endif
\ No newline at end of file
@@ -11,7 +11,7 @@ namespace llvmc::lexer {
         AND = 256, BREAK, REPEAT, ELSE, EQ,
         FALSE, GE, ID, IF, INDEX, LE, MINUS, NE,
         NUM, OR, TRUE, WHILE, UNTIL, TO, DOWNTO,
-        FOR, IDENT, DEIDENT, FUN, LET, RETURN
+        FOR, IDENT, DEIDENT, FUN, LET, RETURN, STR
     };
 
     class Token {
@@ -0,0 +1,52 @@
+#ifndef LLVMC_ILINALG_H_
+#define LLVMC_ILINALG_H_
+#include <optional>
+#include "llvm/IR/Module.h"
+#include "llvm/IR/IRBuilder.h"
+
+namespace llvmc::linalg {
+
+    enum class Kind : unsigned {
+        MatMul, Transpose
+    };
+
+    class Kernel {
+
+        static constexpr inline unsigned vector_bits_ = 256;
+        static constexpr inline unsigned rows_ = 4;
+        static constexpr inline unsigned vecs_ = 2;
+        static constexpr inline unsigned block_ = 4;
+        static constexpr inline uint64_t tile_j_ = 256;
+        static constexpr inline uint64_t tile_k_ = 128;
+        static constexpr inline uint64_t tile_t_ = 32;
+
+        Kind kind_;
+
+        static llvm::Type* acc_type(llvm::IRBuilder<>&,
+            llvm::SmallVectorImpl<llvm::Type*> const&);
+        static llvm::Value* convert(llvm::IRBuilder<>&, llvm::Value*, llvm::Type*);
+        static llvm::Value* emit_distinct(llvm::IRBuilder<>&, llvm::Value*, llvm::Value*);
+        static void emit_check(llvm::IRBuilder<>&, llvm::Value*, char const*);
+        static llvm::Value* emit_min(llvm::IRBuilder<>&, llvm::Value*, llvm::Value*);
+        static llvm::Value* emit_load(llvm::IRBuilder<>&, llvm::Type*,
+            llvm::Value*, llvm::Value*, llvm::Type*);
+        static void emit_store(llvm::IRBuilder<>&, llvm::Type*,
+            llvm::Value*, llvm::Value*, llvm::Value*);
+        static void emit_loop(llvm::IRBuilder<>&, llvm::Value*, llvm::Value*,
+            uint64_t, llvm::function_ref<void(llvm::Value*)>);
+        void emit_panel(llvm::IRBuilder<>&, llvm::Function&,
+            llvm::SmallVectorImpl<llvm::Type*> const&, llvm::Type*, unsigned,
+            llvm::Value*, llvm::Value*, llvm::Value*, llvm::Value*, llvm::Value*) const;
+        void emit_matmul(llvm::Function&, llvm::SmallVectorImpl<llvm::Type*> const&) const;
+        void emit_transpose(llvm::Function&, llvm::SmallVectorImpl<llvm::Type*> const&) const;
+
+    public:
+
+        Kernel(Kind) noexcept;
+        static std::optional<Kind> get_kind(std::string const&);
+        static size_t get_arity(Kind);
+        llvm::Function* get(llvm::Module&,
+            llvm::SmallVectorImpl<llvm::Type*> const&) const;
+    };
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef LLVMC_IMEMO_H_
+#define LLVMC_IMEMO_H_
+#include <unordered_set>
+#include "llvm/IR/Module.h"
+#include "llvm/IR/IRBuilder.h"
+
+namespace llvmc::memo {
+
+    class Memoizer {
+
+        static inline std::unordered_set<llvm::Function const*> pure_{};
+        static constexpr inline uint64_t dense_size_ = 1 << 12;
+        static constexpr inline uint64_t hash_bits_ = 12;
+        static constexpr inline uint64_t hash_size_ = 1 << hash_bits_;
+        static constexpr inline uint64_t max_probe_ = 8;
+
+        bool forced_;
+
+        static bool is_pure(llvm::Function const&);
+        static unsigned self_calls(llvm::Function const&);
+        static llvm::GlobalVariable* emit_table(llvm::Module&,
+            llvm::Type*, uint64_t, std::string const&);
+        static llvm::Value* emit_call(llvm::IRBuilder<>&,
+            llvm::Function&, llvm::Function&);
+        static void emit_dense(llvm::IRBuilder<>&, llvm::Function&,
+            llvm::Function&, llvm::BasicBlock*);
+        static void emit_hash(llvm::IRBuilder<>&, llvm::Function&,
+            llvm::Function&);
+        static void wrap(llvm::Function&);
+
+    public:
+
+        Memoizer(bool = false) noexcept;
+        bool run(llvm::Function&) const;
+    };
+}
+#endif
\ No newline at end of file
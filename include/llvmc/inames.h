@@ -0,0 +1,12 @@
+#ifndef LLVMC_INAMES_H_
+#define LLVMC_INAMES_H_
+#include <string>
+#include "llvm/IR/Type.h"
+
+namespace llvmc::names {
+
+    //appends the suffix generated routines carry per element type:
+    //f32, f64 or i<bits>
+    void append_type(std::string&, llvm::Type*);
+}
+#endif
\ No newline at end of file
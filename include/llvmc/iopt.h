@@ -0,0 +1,24 @@
+#ifndef LLVMC_IOPT_H_
+#define LLVMC_IOPT_H_
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+namespace llvmc::opt {
+
+    enum class Level : unsigned {
+        O0, O1, O2, O3
+    };
+
+    class Pipeline {
+
+        Level level_;
+        bool time_;
+        llvm::TargetMachine* machine_;
+
+    public:
+
+        Pipeline(Level, bool = false, llvm::TargetMachine* = nullptr) noexcept;
+        bool run(llvm::Module&) const;
+    };
+}
+#endif
\ No newline at end of file
@@ -2,40 +2,61 @@
 #define LLVMC_IPARSER_H_
 #include <llvmc/ilex.h>
 #include <llvmc/isymbols.h>
+#include <llvmc/iemit.h>
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 
 namespace llvmc::parser {
 
+    struct Options {
+
+        opt::Level level_{ opt::Level::O0 };
+        bool time_{ false };
+        emit::Kind emit_{ emit::Kind::LL };
+        std::string output_{};
+        bool run_{ false };
+        bool lazy_{ false };
+        unsigned threshold_{ 1000 };
+    };
+
     class Parser {
 
+        static inline std::unique_ptr<llvm::LLVMContext> context_{
+            std::make_unique<llvm::LLVMContext>() };
         static inline unsigned err_num_ = 0;
         static inline unsigned ret_num_ = 0;
         static inline unsigned depth_ = 0;
         static constexpr inline unsigned max_depth_ = 1000;
+        static constexpr inline uint64_t kHugePage = 1 << 21;
+        static constexpr inline int32_t kAdviseHuge = 14;
         
         lexer::Lexer lex_;
         std::string path_;
+        Options opts_;
         std::unique_ptr<lexer::Token> tok_;
+        std::vector<std::unique_ptr<lexer::Token>> back_;
         class EnvGuard;
 
         std::string get_output_name() const;
         void check_end();
         void check_depth();
         void move();
+        void unget(std::unique_ptr<lexer::Token>);
         std::unique_ptr<lexer::Token> match(lexer::Tag);
 
         template<typename T, typename R, typename F>
         R make_bool(R, F);
 
         void program_preinit();
+        void program_runtime();
         void program_postinit();
         void fun_stmts();
-        void fun_def();
+        void fun_def(bool = false);
         std::unique_ptr<inter::Expr> fun_call();
         std::unique_ptr<inter::Stmt> stmts();
         std::unique_ptr<inter::Stmt> stmt();
         std::unique_ptr<inter::Stmt> decls();
+        llvm::Type* elem_type();
         std::unique_ptr<inter::Stmt> assign();
         std::unique_ptr<inter::Expr> pbool();
         std::unique_ptr<inter::Expr> join();
@@ -48,19 +69,22 @@ namespace llvmc::parser {
         std::unique_ptr<inter::Expr> access(
             std::shared_ptr<inter::Id>);
         inter::ArrList expr_seq();
+        std::vector<double> num_seq();
     
     public:
 
-        static inline llvm::LLVMContext Context;
+        static inline llvm::LLVMContext& Context{ *context_ };
         static inline llvm::IRBuilder Builder{ Context };
         static inline std::unique_ptr<llvm::Module> Module{ 
             std::make_unique<llvm::Module>("module", Context) };
         static inline llvm::DataLayout layout{ Module.get() };
-        static inline std::shared_ptr<symbols::Env> top = nullptr;
+        static inline std::unique_ptr<llvm::TargetMachine> Machine = nullptr;
+        static inline std::shared_ptr<symbols::Env> top{ 
+            std::make_shared<symbols::Env>(nullptr) };
 
-        Parser(lexer::Lexer, std::string);
+        Parser(lexer::Lexer, std::string, Options = {});
 
-        void program();
+        int program();
         
         static std::nullptr_t LogErrorV(std::string);
     };
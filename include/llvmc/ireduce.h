@@ -0,0 +1,42 @@
+#ifndef LLVMC_IREDUCE_H_
+#define LLVMC_IREDUCE_H_
+#include <optional>
+#include "llvm/IR/Module.h"
+#include "llvm/IR/IRBuilder.h"
+
+namespace llvmc::reduce {
+
+    enum class Kind : unsigned {
+        Sum, Min, Max, ArgMin, ArgMax, Dot
+    };
+
+    class Reducer {
+
+        static constexpr inline unsigned lanes_ = 4;
+        static constexpr inline unsigned unroll_ = 4;
+
+        Kind kind_;
+
+        static llvm::Value* convert(llvm::IRBuilder<>&, llvm::Value*, llvm::Type*);
+        bool is_arg() const;
+        bool is_min() const;
+        llvm::Type* acc_type(llvm::IRBuilder<>&,
+            llvm::SmallVectorImpl<llvm::Type*> const&) const;
+        llvm::Value* emit_identity(llvm::IRBuilder<>&, llvm::Type*) const;
+        llvm::Value* emit_better(llvm::IRBuilder<>&, llvm::Value*, llvm::Value*) const;
+        llvm::Value* emit_step(llvm::IRBuilder<>&, llvm::Value*, llvm::Value*,
+            llvm::Value*) const;
+        llvm::Value* emit_fold(llvm::IRBuilder<>&, llvm::Value*) const;
+        void emit_body(llvm::Function&,
+            llvm::SmallVectorImpl<llvm::Type*> const&) const;
+
+    public:
+
+        Reducer(Kind) noexcept;
+        static std::optional<Kind> get_kind(std::string const&);
+        static size_t get_arity(Kind);
+        llvm::Function* get(llvm::Module&,
+            llvm::SmallVectorImpl<llvm::Type*> const&) const;
+    };
+}
+#endif
\ No newline at end of file
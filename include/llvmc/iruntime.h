@@ -0,0 +1,31 @@
+#ifndef LLVMC_IRUNTIME_H_
+#define LLVMC_IRUNTIME_H_
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    //the routines behind print and read, linked into every program
+    double llvmc_print(double);
+    void llvmc_flush(void);
+    double llvmc_read_f64(double*, int64_t);
+    double llvmc_read_f32(float*, int64_t);
+    double llvmc_read_i64(int64_t*, int64_t);
+    double llvmc_read_i32(int32_t*, int64_t);
+
+    //stops the program on an error only found at run time
+    void llvmc_fail(char const*);
+
+    //arrays declared as mapped live in a mapping of their file
+    enum {
+        LLVMC_MAP_SHARED = 1,
+        LLVMC_MAP_RANDOM = 2
+    };
+    void* llvmc_map(char const*, int64_t, int32_t);
+    void llvmc_unmap(void*);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef LLVMC_ISORT_H_
+#define LLVMC_ISORT_H_
+#include "llvm/IR/Module.h"
+#include "llvm/IR/IRBuilder.h"
+
+namespace llvmc::sort {
+
+    class Sorter {
+
+        static constexpr inline uint64_t small_size_ = 16;
+
+        llvm::Type* elem_;
+        std::string name_;
+
+        llvm::Value* emit_at(llvm::IRBuilder<>&, llvm::Value*, llvm::Value*) const;
+        llvm::Value* emit_less(llvm::IRBuilder<>&, llvm::Value*, llvm::Value*) const;
+        void emit_swap(llvm::IRBuilder<>&, llvm::Value*, llvm::Value*) const;
+        llvm::Function* create(llvm::Module&, std::string const&,
+            llvm::ArrayRef<llvm::Type*>) const;
+        llvm::Function* emit_insertion(llvm::Module&) const;
+        llvm::Function* emit_sift(llvm::Module&) const;
+        llvm::Function* emit_heap(llvm::Module&, llvm::Function*) const;
+        llvm::Function* emit_intro(llvm::Module&) const;
+
+    public:
+
+        Sorter(llvm::Type*);
+        llvm::Function* get(llvm::Module&) const;
+    };
+}
+#endif
\ No newline at end of file
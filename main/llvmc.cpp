@@ -3,17 +3,69 @@
 #include <filesystem>
 #include <llvmc/ilex.h>
 #include <llvmc/iparser.h>
+#include "llvm/Support/CommandLine.h"
+
+namespace cl = llvm::cl;
+
+static cl::opt<std::string> InputFilename(cl::Positional,
+    cl::desc("<input file>"), cl::Required);
+
+static cl::opt<char> OptLevel("O",
+    cl::desc("Optimization level. [-O0, -O1, -O2, or -O3] (default = '-O0')"),
+    cl::Prefix, cl::init('0'));
+
+static cl::opt<std::string> OutputFilename("o",
+    cl::desc("Output filename"), cl::value_desc("filename"));
+
+static cl::opt<llvmc::emit::Kind> EmitKind("emit",
+    cl::desc("Kind of output to produce (default = ll)"),
+    cl::values(
+        clEnumValN(llvmc::emit::Kind::LL, "ll", "textual LLVM IR"),
+        clEnumValN(llvmc::emit::Kind::BC, "bc", "LLVM bitcode"),
+        clEnumValN(llvmc::emit::Kind::ASM, "asm", "native assembly"),
+        clEnumValN(llvmc::emit::Kind::OBJ, "obj", "native object file"),
+        clEnumValN(llvmc::emit::Kind::EXE, "exe", "linked executable")),
+    cl::init(llvmc::emit::Kind::LL));
+
+static cl::opt<bool> Run("run",
+    cl::desc("Compile the program in memory and execute its main"));
+
+static cl::opt<bool> Lazy("lazy",
+    cl::desc("With --run, compile functions on first call and re-optimize hot ones in the background"));
+
+static cl::opt<unsigned> HotThreshold("hot-threshold",
+    cl::desc("Number of calls after which --lazy recompiles a function at -O3 (0 disables)"),
+    cl::init(1000));
+
+static cl::opt<bool> TimeOpt("time-opt",
+    cl::desc("Report time spent in the optimization pipeline"));
 
 int main(int argc, char* argv[]){
 
     namespace fs = std::filesystem;
 
-    if(argc != 2) {
-        llvm::errs() << "Error: wrong argument numbers\n";
-        return 1;
+    cl::ParseCommandLineOptions(argc, argv, "pseudocode compiler\n");
+
+    llvmc::parser::Options opts{};
+
+    switch(OptLevel) {
+
+        case '0': opts.level_ = llvmc::opt::Level::O0; break;
+        case '1': opts.level_ = llvmc::opt::Level::O1; break;
+        case '2': opts.level_ = llvmc::opt::Level::O2; break;
+        case '3': opts.level_ = llvmc::opt::Level::O3; break;
+        default:
+            llvm::errs() << "Error: invalid optimization level -O" << OptLevel << '\n';
+            return 1;
     }
+    opts.time_ = TimeOpt;
+    opts.emit_ = EmitKind;
+    opts.output_ = OutputFilename;
+    opts.run_ = Run;
+    opts.lazy_ = Lazy;
+    opts.threshold_ = HotThreshold;
 
-    std::string program_path{ argv[1] };
+    std::string program_path{ InputFilename };
 
     if(!fs::exists(program_path)) {
         llvm::errs() << "Error: no such file " << program_path << '\n';
@@ -24,6 +76,6 @@ int main(int argc, char* argv[]){
     llvmc::lexer::Lexer lex{ std::string{ (std::istreambuf_iterator<char>(in)),
                        std::istreambuf_iterator<char>() } };
 
-    llvmc::parser::Parser par{ std::move(lex), program_path };
-    par.program();
+    llvmc::parser::Parser par{ std::move(lex), program_path, opts };
+    return par.program();
 }
\ No newline at end of file
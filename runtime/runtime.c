@@ -0,0 +1,388 @@
+#include <llvmc/iruntime.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+enum {
+    kBufSize = 1 << 16,
+    //no line print writes is longer than this
+    kMaxLine = 400,
+    kInSize = 1 << 20,
+    //a number is parsed only once this much input, or all of it, is at hand
+    kMaxToken = 1 << 12,
+    kPad = 16
+};
+
+typedef struct {
+
+    size_t len;
+    char data[kBufSize];
+} Buffer;
+
+//each thread fills its own buffer, so print never takes a lock
+static _Thread_local Buffer out_;
+
+static void flush(Buffer* b) {
+
+    if(!b->len) return;
+
+    fwrite(b->data, 1, b->len, stdout);
+    fflush(stdout);
+    b->len = 0;
+}
+
+//writes x the way printf("%lf\n") does; the fraction is rounded in
+//integers unless it lies too close to a tie to trust the double product
+static size_t format(char* p, double x) {
+
+    double a = fabs(x);
+    if(!(a < 9007199254740992.0))
+        return (size_t)snprintf(p, kMaxLine, "%lf\n", x);
+
+    uint64_t ip = (uint64_t)a;
+    double frac = (a - (double)ip) * 1e6;
+    uint64_t fp = (uint64_t)frac;
+    double rem = frac - (double)fp;
+    if(fabs(rem - 0.5) < 1e-3)
+        return (size_t)snprintf(p, kMaxLine, "%lf\n", x);
+
+    fp += rem > 0.5;
+    if(fp == 1000000) {
+
+        ++ip;
+        fp = 0;
+    }
+
+    char digits[24];
+    size_t n = 0;
+    do {
+
+        digits[n++] = (char)('0' + ip % 10);
+        ip /= 10;
+    } while(ip);
+
+    char* q = p;
+    if(signbit(x)) *q++ = '-';
+    while(n) *q++ = digits[--n];
+
+    *q++ = '.';
+    for(int i = 5; i >= 0; i--) {
+
+        q[i] = (char)('0' + fp % 10);
+        fp /= 10;
+    }
+    q += 6;
+    *q++ = '\n';
+
+    return (size_t)(q - p);
+}
+
+double llvmc_print(double x) {
+
+    Buffer* b = &out_;
+    if(b->len > kBufSize - kMaxLine) flush(b);
+
+    size_t n = format(b->data + b->len, x);
+    b->len += n;
+
+    return (double)n;
+}
+
+void llvmc_flush(void) {
+
+    flush(&out_);
+}
+
+void llvmc_fail(char const* what) {
+
+    flush(&out_);
+    fprintf(stderr, "error: %s\n", what);
+    exit(1);
+}
+
+//stdin is shared by all threads, so is the buffer it is read through;
+//the bytes past the data are kept zero, which ends every scan
+static struct {
+
+    size_t pos, len;
+    int eof;
+    char data[kInSize + kPad];
+} in_;
+
+static void refill(void) {
+
+    if(in_.eof || in_.len - in_.pos >= kMaxToken) return;
+
+    memmove(in_.data, in_.data + in_.pos, in_.len - in_.pos);
+    in_.len -= in_.pos;
+    in_.pos = 0;
+
+    while(!in_.eof && in_.len < kInSize) {
+
+        size_t n = fread(in_.data + in_.len, 1, kInSize - in_.len, stdin);
+        in_.len += n;
+        if(!n) in_.eof = 1;
+    }
+    memset(in_.data + in_.len, 0, kPad);
+}
+
+static int is_space(char c) {
+
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static int is_digit(char c) {
+
+    return (unsigned char)(c - '0') < 10;
+}
+
+//out of range values saturate instead of being undefined
+static int64_t to_int(double x) {
+
+    if(x != x) return 0;
+    if(x >= 9223372036854775807.0) return INT64_MAX;
+    if(x <= -9223372036854775808.0) return INT64_MIN;
+
+    return (int64_t)x;
+}
+
+//eight digits at once, as in simdjson and fast_float
+static int parse8(char const* p, uint64_t* v) {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t w;
+    memcpy(&w, p, sizeof w);
+    if(((w & 0xF0F0F0F0F0F0F0F0ull)
+        | (((w + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))
+        != 0x3333333333333333ull) return 0;
+
+    w -= 0x3030303030303030ull;
+    w = w * 10 + (w >> 8);
+    *v = (((w & 0x000000FF000000FFull) * (100 + (1000000ull << 32)))
+        + (((w >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+
+    return 1;
+#else
+    (void)p;
+    (void)v;
+
+    return 0;
+#endif
+}
+
+//accumulates up to 19 significant digits into m, counting the rest in *drop
+static char const* digits(char const* p, uint64_t* m, int* n, int* drop) {
+
+    uint64_t v;
+    while(*n <= 11 && parse8(p, &v)) {
+
+        *m = *m * 100000000 + v;
+        *n += 8;
+        p += 8;
+    }
+    for(; is_digit(*p); p++) {
+
+        if(*n < 19) {
+
+            *m = *m * 10 + (uint64_t)(*p - '0');
+            if(*m) ++*n;
+        }
+        else ++*drop;
+    }
+
+    return p;
+}
+
+//parses the number starting at p into *x and returns its end, or p when
+//there is none; mantissas of up to 2^53 scaled by at most 10^22 are exact
+//in double, everything else goes through strtod
+static char const* parse(char const* p, double* x, int64_t* i) {
+
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+        1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+        1e20, 1e21, 1e22 };
+
+    char const* s = p;
+    int neg = *p == '-';
+    if(*p == '-' || *p == '+') ++p;
+
+    uint64_t m = 0;
+    int n = 0, drop = 0, frac = 0;
+    char const* q = digits(p, &m, &n, &drop);
+    int whole = q != p;
+    if(*q == '.') {
+
+        char const* f = q + 1;
+        q = digits(f, &m, &n, &drop);
+        frac = (int)(q - f);
+        whole |= q != f;
+    }
+    if(!whole) {
+
+        char* end;
+        *x = strtod(s, &end);
+        *i = to_int(*x);
+
+        return end;
+    }
+
+    int exp = 0;
+    if(*q == 'e' || *q == 'E') {
+
+        char const* e = q + 1;
+        int eneg = *e == '-';
+        if(*e == '-' || *e == '+') ++e;
+        if(is_digit(*e)) {
+
+            for(; is_digit(*e); e++)
+                if(exp < 100000) exp = exp * 10 + (*e - '0');
+            if(eneg) exp = -exp;
+            q = e;
+        }
+    }
+
+    //plain integers keep all 64 bits
+    if(!frac && !exp && !drop && m <= (uint64_t)INT64_MAX) {
+
+        *i = neg ? -(int64_t)m : (int64_t)m;
+        *x = (double)*i;
+
+        return q;
+    }
+
+    int e10 = exp - frac + drop;
+    if(!drop && m <= (1ull << 53) && e10 >= -22 && e10 <= 22) {
+
+        double d = (double)m;
+        d = e10 < 0 ? d / pow10[-e10] : d * pow10[e10];
+        *x = neg ? -d : d;
+    }
+    else *x = strtod(s, NULL);
+
+    *i = to_int(*x);
+
+    return q;
+}
+
+//reads up to n numbers into p, stopping at the end of the input or at
+//anything that is not a number, and returns how many were stored
+#define LLVMC_READ(name, T, integral)                                       \
+    double name(T* p, int64_t n) {                                          \
+                                                                            \
+        flush(&out_);                                                       \
+                                                                            \
+        int64_t k = 0;                                                      \
+        for(; k < n; k++) {                                                 \
+                                                                            \
+            refill();                                                       \
+            while(is_space(in_.data[in_.pos])) {                            \
+                                                                            \
+                ++in_.pos;                                                  \
+                if(in_.pos == in_.len) refill();                            \
+            }                                                               \
+            if(in_.pos == in_.len) break;                                   \
+                                                                            \
+            refill();                                                       \
+            double x;                                                       \
+            int64_t i;                                                      \
+            char const* s = in_.data + in_.pos;                             \
+            char const* e = parse(s, &x, &i);                               \
+            if(e == s) break;                                               \
+                                                                            \
+            in_.pos += (size_t)(e - s);                                     \
+            p[k] = integral ? (T)i : (T)x;                                  \
+        }                                                                   \
+                                                                            \
+        return (double)k;                                                   \
+    }
+
+LLVMC_READ(llvmc_read_f64, double, 0)
+LLVMC_READ(llvmc_read_f32, float, 0)
+LLVMC_READ(llvmc_read_i64, int64_t, 1)
+LLVMC_READ(llvmc_read_i32, int32_t, 1)
+
+//the mappings still alive, so that unmapping needs only the address
+typedef struct Mapping {
+
+    void* data;
+    size_t len;
+    struct Mapping* next;
+} Mapping;
+
+static Mapping* maps_;
+
+static void fail(char const* path, char const* what) {
+
+    flush(&out_);
+    fprintf(stderr, "error: %s: %s\n", path, what);
+    exit(1);
+}
+
+void* llvmc_map(char const* path, int64_t bytes, int32_t flags) {
+
+#ifndef _WIN32
+    int shared = flags & LLVMC_MAP_SHARED;
+    int fd = open(path, shared ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if(fd < 0) fail(path, strerror(errno));
+
+    //a private mapping must not reach past the end of the file,
+    //a shared one grows the file to the size of the array
+    struct stat st;
+    if(fstat(fd, &st)) fail(path, strerror(errno));
+    if(st.st_size < bytes) {
+
+        if(!shared) fail(path, "file is smaller than the array");
+        if(ftruncate(fd, (off_t)bytes)) fail(path, strerror(errno));
+    }
+
+    size_t len = bytes > 0 ? (size_t)bytes : 1;
+    void* p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+        shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) fail(path, strerror(errno));
+
+    madvise(p, len, flags & LLVMC_MAP_RANDOM ? MADV_RANDOM : MADV_SEQUENTIAL);
+
+    Mapping* m = malloc(sizeof *m);
+    if(!m) fail(path, "out of memory");
+    m->data = p;
+    m->len = len;
+    m->next = maps_;
+    maps_ = m;
+
+    return p;
+#else
+    (void)bytes;
+    (void)flags;
+    fail(path, "mapped arrays are not supported on this platform");
+
+    return NULL;
+#endif
+}
+
+void llvmc_unmap(void* p) {
+
+#ifndef _WIN32
+    for(Mapping** m = &maps_; *m; m = &(*m)->next)
+        if((*m)->data == p) {
+
+            Mapping* dead = *m;
+            *m = dead->next;
+            munmap(dead->data, dead->len);
+            free(dead);
+
+            return;
+        }
+#else
+    (void)p;
+#endif
+}
@@ -0,0 +1,143 @@
+#include <llvmc/iattrs.h>
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+
+namespace llvmc::attrs {
+
+    using namespace llvm;
+
+    Inferer::Inferer(bool i) noexcept : internalize_{ i } {}
+
+    bool Inferer::is_local(Value const* Ptr) {
+
+        while(auto GEP = dyn_cast<GEPOperator>(Ptr))
+            Ptr = GEP->getPointerOperand();
+
+        return isa<AllocaInst>(Ptr);
+    }
+
+    Memory Inferer::get_memory(Function const& F, SCC const& scc) {
+
+        Memory ret = Memory::None;
+
+        for(auto& I : instructions(F)) {
+
+            if(auto CB = dyn_cast<CallBase>(&I)) {
+
+                auto Callee = CB->getCalledFunction();
+                if(!Callee) return Memory::Any;
+
+                //members of the same cycle are assumed to agree
+                if(scc.count(Callee) || Callee->doesNotAccessMemory()) continue;
+                if(!Callee->onlyReadsMemory()) return Memory::Any;
+
+                ret = Memory::Read;
+            }
+            else if(auto SI = dyn_cast<StoreInst>(&I)) {
+
+                if(!is_local(SI->getPointerOperand())) return Memory::Any;
+            }
+            else if(auto LI = dyn_cast<LoadInst>(&I)) {
+
+                //a constant table reads the same on every call
+                Value const* Ptr = LI->getPointerOperand();
+                while(auto GEP = dyn_cast<GEPOperator>(Ptr))
+                    Ptr = GEP->getPointerOperand();
+                auto G = dyn_cast<GlobalVariable>(Ptr->stripPointerCasts());
+                if(!is_local(Ptr) && !(G && G->isConstant())) ret = Memory::Read;
+            }
+            else if(I.mayReadOrWriteMemory()) return Memory::Any;
+        }
+
+        return ret;
+    }
+
+    bool Inferer::will_return(Function& F, bool rec) {
+
+        if(rec) return false;
+
+        //any loop may run forever
+        SmallVector<std::pair<BasicBlock const*, BasicBlock const*>, 4> edges;
+        FindFunctionBackedges(F, edges);
+        if(!edges.empty()) return false;
+
+        for(auto& I : instructions(F))
+            if(auto CB = dyn_cast<CallBase>(&I)) {
+
+                auto Callee = CB->getCalledFunction();
+                if(!Callee || !Callee->hasFnAttribute(Attribute::WillReturn))
+                    return false;
+            }
+
+        return true;
+    }
+
+    void Inferer::infer(std::vector<Function*> const& fs) const {
+
+        SCC scc{ fs.begin(), fs.end() };
+        bool rec = fs.size() > 1;
+        Memory mem = Memory::None;
+
+        for(auto F : fs) {
+
+            for(auto& I : instructions(*F))
+                if(auto CB = dyn_cast<CallBase>(&I)) {
+
+                    auto Callee = CB->getCalledFunction();
+                    //an external callee could call back into the program
+                    rec |= Callee == F || !Callee || (Callee->isDeclaration()
+                        && !Callee->hasFnAttribute(Attribute::NoRecurse));
+                }
+
+            mem = std::max(mem, get_memory(*F, scc));
+        }
+
+        for(auto F : fs) {
+
+            //the language has no exceptions
+            F->addFnAttr(Attribute::NoUnwind);
+
+            if(mem == Memory::None) F->addFnAttr(Attribute::ReadNone);
+            else if(mem == Memory::Read) F->addFnAttr(Attribute::ReadOnly);
+
+            if(!rec) F->addFnAttr(Attribute::NoRecurse);
+            if(will_return(*F, rec)) F->addFnAttr(Attribute::WillReturn);
+        }
+    }
+
+    void Inferer::run(Module& M) const {
+
+        //neither the runtime library nor the C routines it uses call back
+        for(auto name : { "llvmc_print", "llvmc_flush", "llvmc_read_f64",
+            "llvmc_read_f32", "llvmc_read_i64", "llvmc_read_i32", "llvmc_fail",
+            "llvmc_map", "llvmc_unmap", "free",
+            "posix_memalign", "madvise", "abort" })
+            if(auto F = M.getFunction(name)) {
+
+                F->addFnAttr(Attribute::NoUnwind);
+                F->addFnAttr(Attribute::NoRecurse);
+            }
+
+        //callees are visited before their callers
+        CallGraph CG{ M };
+        for(auto I = scc_begin(&CG); !I.isAtEnd(); ++I) {
+
+            std::vector<Function*> fs;
+            for(auto N : *I)
+                if(auto F = N->getFunction(); F && !F->isDeclaration())
+                    fs.push_back(F);
+
+            if(!fs.empty()) infer(fs);
+        }
+
+        //main is the only entry point of a program
+        if(internalize_)
+            for(auto& F : M)
+                if(!F.isDeclaration() && F.getName() != "main")
+                    F.setLinkage(GlobalValue::InternalLinkage);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include <llvmc/ibits.h>
+#include <unordered_map>
+
+namespace llvmc::bits {
+
+    using namespace llvm;
+
+    Routine::Routine(Kind k) noexcept : kind_{ k } {}
+
+    std::optional<Kind> Routine::get_kind(std::string const& name) {
+
+        static const std::unordered_map<std::string, Kind> kinds{
+            { "popcount", Kind::PopCount }, { "findfirst", Kind::FindFirst },
+            { "clear", Kind::Clear } };
+
+        if(auto it = kinds.find(name); it != kinds.end()) return it->second;
+
+        return std::nullopt;
+    }
+
+    Value* Routine::emit_words(IRBuilder<>& B, Function& F) {
+
+        return B.CreateLShr(B.CreateAdd(F.getArg(1),
+            B.getInt64(word_bits_ - 1)), Log2_64(word_bits_));
+    }
+    void Routine::emit_popcount(Function& F) {
+
+        //counts the set bits a word at a time
+        auto& C = F.getContext();
+        auto I64 = Type::getInt64Ty(C);
+        auto EntryBB = BasicBlock::Create(C, "", &F);
+        auto HeadBB = BasicBlock::Create(C, "", &F);
+        auto BodyBB = BasicBlock::Create(C, "", &F);
+        auto DoneBB = BasicBlock::Create(C, "", &F);
+        IRBuilder<> B{ EntryBB };
+        auto N = emit_words(B, F);
+        B.CreateBr(HeadBB);
+
+        B.SetInsertPoint(HeadBB);
+        auto I = B.CreatePHI(I64, 2);
+        auto Sum = B.CreatePHI(I64, 2);
+        I->addIncoming(B.getInt64(0), EntryBB);
+        Sum->addIncoming(B.getInt64(0), EntryBB);
+        B.CreateCondBr(B.CreateICmpULT(I, N), BodyBB, DoneBB);
+
+        B.SetInsertPoint(BodyBB);
+        auto W = B.CreateLoad(I64, B.CreateGEP(I64, F.getArg(0), I));
+        I->addIncoming(B.CreateAdd(I, B.getInt64(1)), BodyBB);
+        Sum->addIncoming(B.CreateAdd(Sum,
+            B.CreateUnaryIntrinsic(Intrinsic::ctpop, W)), BodyBB);
+        B.CreateBr(HeadBB);
+
+        B.SetInsertPoint(DoneBB);
+        B.CreateRet(B.CreateUIToFP(Sum, F.getReturnType()));
+    }
+    void Routine::emit_findfirst(Function& F) {
+
+        //the index of the lowest set bit, or -1
+        auto& C = F.getContext();
+        auto I64 = Type::getInt64Ty(C);
+        auto EntryBB = BasicBlock::Create(C, "", &F);
+        auto HeadBB = BasicBlock::Create(C, "", &F);
+        auto BodyBB = BasicBlock::Create(C, "", &F);
+        auto NextBB = BasicBlock::Create(C, "", &F);
+        auto FoundBB = BasicBlock::Create(C, "", &F);
+        auto DoneBB = BasicBlock::Create(C, "", &F);
+        IRBuilder<> B{ EntryBB };
+        auto N = emit_words(B, F);
+        B.CreateBr(HeadBB);
+
+        B.SetInsertPoint(HeadBB);
+        auto I = B.CreatePHI(I64, 2);
+        I->addIncoming(B.getInt64(0), EntryBB);
+        B.CreateCondBr(B.CreateICmpULT(I, N), BodyBB, DoneBB);
+
+        B.SetInsertPoint(BodyBB);
+        auto W = B.CreateLoad(I64, B.CreateGEP(I64, F.getArg(0), I));
+        B.CreateCondBr(B.CreateICmpNE(W, B.getInt64(0)), FoundBB, NextBB);
+
+        B.SetInsertPoint(NextBB);
+        I->addIncoming(B.CreateAdd(I, B.getInt64(1)), NextBB);
+        B.CreateBr(HeadBB);
+
+        B.SetInsertPoint(FoundBB);
+        auto Low = B.CreateBinaryIntrinsic(Intrinsic::cttz, W, B.getTrue());
+        B.CreateRet(B.CreateUIToFP(B.CreateAdd(
+            B.CreateShl(I, Log2_64(word_bits_)), Low), F.getReturnType()));
+
+        B.SetInsertPoint(DoneBB);
+        B.CreateRet(ConstantFP::get(F.getReturnType(), -1.0));
+    }
+    void Routine::emit_clear(Function& F) {
+
+        //empties the whole set
+        IRBuilder<> B{ BasicBlock::Create(F.getContext(), "", &F) };
+        B.CreateMemSet(F.getArg(0), B.getInt8(0),
+            B.CreateShl(emit_words(B, F), Log2_64(word_bits_ / 8)),
+            MaybeAlign(word_bits_ / 8));
+        B.CreateRet(ConstantFP::get(F.getReturnType(), 0.0));
+    }
+
+    Function* Routine::get(Module& M) const {
+
+        static const char* const names[]{
+            "llvmc.popcount", "llvmc.findfirst", "llvmc.clear" };
+        auto name = names[static_cast<unsigned>(kind_)];
+
+        if(auto F = M.getFunction(name)) return F;
+
+        //a bits array comes as its words followed by its length in bits
+        auto& C = M.getContext();
+        auto I64 = Type::getInt64Ty(C);
+        auto F = Function::Create(FunctionType::get(Type::getDoubleTy(C),
+            { PointerType::getUnqual(I64), I64 }, false),
+            Function::ExternalLinkage, name, &M);
+        F->addFnAttr(Attribute::NoUnwind);
+
+        if(kind_ == Kind::PopCount) emit_popcount(*F);
+        else if(kind_ == Kind::FindFirst) emit_findfirst(*F);
+        else emit_clear(*F);
+
+        return F;
+    }
+}
\ No newline at end of file
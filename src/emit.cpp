@@ -0,0 +1,149 @@
+#include <llvmc/iemit.h>
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#if LLVM_VERSION_MAJOR < 14
+#include "llvm/Support/TargetRegistry.h"
+#else
+#include "llvm/MC/TargetRegistry.h"
+#endif
+
+namespace llvmc::emit {
+
+    using namespace llvm;
+
+    Emitter::Emitter(Kind k, std::string p, TargetMachine* TM) noexcept
+        : kind_{ k }, path_{ std::move(p) }, machine_{ TM } {}
+
+    std::unique_ptr<TargetMachine> Emitter::create_machine(opt::Level l) {
+
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+
+        auto triple = sys::getDefaultTargetTriple();
+        std::string err;
+
+        auto T = TargetRegistry::lookupTarget(triple, err);
+        if(!T) {
+
+            errs() << "error: " << err << '\n';
+            return nullptr;
+        }
+
+        SubtargetFeatures features;
+        StringMap<bool> host;
+        if(sys::getHostCPUFeatures(host))
+            for(auto& F : host)
+                features.AddFeature(F.first(), F.second);
+
+        CodeGenOpt::Level CGL = CodeGenOpt::None;
+        switch(l) {
+
+            case opt::Level::O1: CGL = CodeGenOpt::Less; break;
+            case opt::Level::O2: CGL = CodeGenOpt::Default; break;
+            case opt::Level::O3: CGL = CodeGenOpt::Aggressive; break;
+        }
+
+        return std::unique_ptr<TargetMachine>{ T->createTargetMachine(
+            triple, sys::getHostCPUName(), features.getString(),
+            TargetOptions{}, Reloc::PIC_, None, CGL) };
+    }
+
+    std::string Emitter::get_extension(Kind k) {
+
+        switch(k) {
+
+            case Kind::LL: return ".ll";
+            case Kind::BC: return ".bc";
+            case Kind::ASM: return ".s";
+            case Kind::OBJ: return ".o";
+        }
+
+        return "";
+    }
+
+    bool Emitter::emit_file(Module& M, std::string const& path, Kind k) const {
+
+        std::error_code EC;
+        raw_fd_ostream out{ path, EC,
+            k == Kind::LL || k == Kind::ASM ? sys::fs::OF_Text : sys::fs::OF_None };
+
+        if(EC) {
+
+            errs() << "error: " << path << ": " << EC.message() << '\n';
+            return false;
+        }
+
+        switch(k) {
+
+            case Kind::LL:
+                M.print(out, nullptr);
+                return true;
+            case Kind::BC:
+                WriteBitcodeToFile(M, out);
+                return true;
+        }
+
+        if(!machine_) return false;
+
+        legacy::PassManager PM;
+        auto FT = k == Kind::ASM ? CGFT_AssemblyFile : CGFT_ObjectFile;
+
+        if(machine_->addPassesToEmitFile(PM, out, nullptr, FT)) {
+
+            errs() << "error: target can't emit a file of this type\n";
+            return false;
+        }
+
+        PM.run(M);
+        out.flush();
+
+        return true;
+    }
+
+    bool Emitter::link(std::string const& obj) const {
+
+        auto cc = sys::findProgramByName("cc");
+        if(!cc) {
+
+            errs() << "error: unable to find system linker driver 'cc'\n";
+            return false;
+        }
+
+        SmallVector<StringRef, 8> args{ *cc, obj, LLVMC_RUNTIME, "-o", path_, "-lm" };
+        std::string err;
+
+        if(sys::ExecuteAndWait(*cc, args, None, {}, 0, 0, &err)) {
+
+            errs() << "error: linking failed"
+                << (err.empty() ? "" : ": " + err) << '\n';
+            return false;
+        }
+
+        return true;
+    }
+
+    bool Emitter::run(Module& M) const {
+
+        if(kind_ != Kind::EXE)
+            return emit_file(M, path_, kind_);
+
+        SmallString<128> obj;
+        if(auto EC = sys::fs::createTemporaryFile("llvmc", "o", obj)) {
+
+            errs() << "error: " << EC.message() << '\n';
+            return false;
+        }
+
+        bool ret = emit_file(M, obj.str().str(), Kind::OBJ) && link(obj.str().str());
+        sys::fs::remove(obj);
+
+        return ret;
+    }
+}
\ No newline at end of file
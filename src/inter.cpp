@@ -1,5 +1,14 @@
 #include <llvmc/iinter.h>
+#include <llvmc/iruntime.h>
 #include <llvmc/iparser.h>
+#include <llvmc/inames.h>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Support/SwapByteOrder.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
 
 namespace llvmc::inter {
 
@@ -10,29 +19,187 @@ namespace llvmc::inter {
     Node::~Node() = default;
 
     Expr::Expr(std::unique_ptr<Token> t) noexcept : op_{ std::move(t) } {}
+    bool Expr::is_integral() const {
+
+        return false;
+    }
+    bool Expr::has_array() const {
+
+        return IArray::is_array(this);
+    }
+    bool Expr::is_indirect() const {
+
+        return false;
+    }
+    Value* Expr::emit_lane(Value* I) {
+
+        //operands without arrays are broadcast: they are evaluated once,
+        //before the loop, and reused by every lane
+        if(!I) return lanes_[this] = compile();
+
+        return lanes_[this];
+    }
+    Type* Expr::scalar_type(bool integral) {
+
+        if(integral) return Parser::Builder.getInt64Ty();
+
+        return Parser::Builder.getDoubleTy();
+    }
+    Value* Expr::to_double(Value* V) {
+
+        if(V->getType()->isIntegerTy(1))
+            return Parser::Builder.CreateUIToFP(V, Parser::Builder.getDoubleTy());
+        if(V->getType()->isIntegerTy())
+            return Parser::Builder.CreateSIToFP(V, Parser::Builder.getDoubleTy());
+
+        return V;
+    }
+    Value* Expr::to_integer(Value* V) {
+
+        if(V->getType()->isIntegerTy(1))
+            return Parser::Builder.CreateZExt(V, Parser::Builder.getInt64Ty());
+
+        return V;
+    }
+    Value* Expr::to_index(Value* V) {
+
+        if(V->getType()->isIntegerTy())
+            return Parser::Builder.CreateSExtOrTrunc(
+                to_integer(V), Parser::Builder.getInt64Ty());
+
+        return Parser::Builder.CreateFPToUI(V, Parser::Builder.getInt64Ty());
+    }
+    Value* Expr::to_cond(Value* V) {
+
+        if(V->getType()->isIntegerTy(1)) return V;
+        if(V->getType()->isIntegerTy())
+            return Parser::Builder.CreateICmpNE(V, 
+                ConstantInt::get(V->getType(), 0));
+
+        return Parser::Builder.CreateFCmpUNE(V, 
+            ConstantFP::get(V->getType(), 0.0));
+    }
+
+    Value* Expr::from_elem(Value* V) {
+
+        //narrow elements are widened to the scalar types on load
+        if(V->getType()->isIntegerTy())
+            return Parser::Builder.CreateSExtOrTrunc(V, Parser::Builder.getInt64Ty());
+        if(V->getType()->isFloatTy())
+            return Parser::Builder.CreateFPExt(V, Parser::Builder.getDoubleTy());
+
+        return V;
+    }
+    Value* Expr::to_elem(Value* V, Type* T) {
+
+        if(T->isIntegerTy()) {
+
+            V = to_integer(V);
+            if(V->getType()->isFloatingPointTy()) {
+
+                //out of range values saturate, as in constant initializers
+                auto& B = Parser::Builder;
+#if LLVM_VERSION_MAJOR >= 12
+                return B.CreateIntrinsic(Intrinsic::fptosi_sat,
+                    { T, V->getType() }, { V });
+#else
+                auto Bits = T->getIntegerBitWidth();
+                auto Max = APInt::getSignedMaxValue(Bits);
+                auto Min = APInt::getSignedMinValue(Bits);
+                auto R = B.CreateSelect(B.CreateFCmpOLE(V,
+                    ConstantFP::get(V->getType(), Min.roundToDouble(true))),
+                    ConstantInt::get(T, Min), B.CreateFPToSI(V, T));
+                R = B.CreateSelect(B.CreateFCmpOGE(V,
+                    ConstantFP::get(V->getType(), Max.roundToDouble(true))),
+                    ConstantInt::get(T, Max), R);
+
+                return B.CreateSelect(B.CreateFCmpUNO(V, V),
+                    ConstantInt::get(T, 0), R);
+#endif
+            }
+
+            return Parser::Builder.CreateSExtOrTrunc(V, T);
+        }
+
+        V = to_double(V);
+        if(T->isFloatTy())
+            return Parser::Builder.CreateFPTrunc(V, T);
+
+        return V;
+    }
 
     Id::Id(std::unique_ptr<Token> t, Value* V) 
         : Expr{ std::move(t) }, var_{ V } {}
+    AllocaInst* Id::emit_alloca(Type* T) {
+
+        //stack slots always live in the entry block, so a declaration
+        //inside a loop body doesn't grow the stack on every iteration
+        auto& Entry = Parser::Builder.GetInsertBlock()->getParent()->getEntryBlock();
+        IRBuilder<> B{ &Entry, Entry.begin() };
+
+        return B.CreateAlloca(T, nullptr);
+    }
     std::shared_ptr<Id> Id::get_id(std::unique_ptr<Token> t) {
 
-        Value* V = Parser::Builder.CreateAlloca(
-                    Parser::Builder.getDoubleTy(), nullptr);
         std::string name = static_cast<Word*>(t.get())->lexeme_;
 
         if(Parser::top->get_current(name)) 
             return Parser::LogErrorV("redefinition of \'" + name + '\'');
         
-        auto sp = std::shared_ptr<Id>{ new Id{ std::move(t), V } };
+        //the slot is created on first use, once the type is inferred
+        auto sp = std::shared_ptr<Id>{ new Id{ std::move(t), nullptr } };
         Parser::top->insert(name,  sp);
+        scope_.push_back(sp.get());
 
         return sp;
     }
+    void Id::infer() {
+
+        //every variable starts integral and is demoted to double once
+        //any value assigned to it may be fractional, until nothing changes
+        for(bool changed = true; changed;) {
+
+            changed = false;
+
+            for(auto id : scope_) {
+
+                if(!id->integral_) continue;
+
+                if(std::any_of(id->defs_.begin(), id->defs_.end(),
+                    [](auto e) { return !e || !e->is_integral(); })) {
+
+                    id->integral_ = false;
+                    changed = true;
+                }
+            }
+        }
+
+        scope_.clear();
+    }
+    void Id::add_def(Expr const* e) {
+
+        defs_.push_back(e);
+    }
+    void Id::set_integral(bool b) {
+
+        integral_ = b;
+    }
+    bool Id::is_integral() const {
+
+        return integral_;
+    }
     Value* Id::get_val() const {
 
         return var_;
     }
+    void Id::set_val(Value* V) {
+
+        var_ = V;
+    }
     Value* Id::compile() {
 
+        if(!var_) var_ = emit_alloca(scalar_type(integral_));
+
         return var_;
     }
 
@@ -43,22 +210,42 @@ namespace llvmc::inter {
         
         return false;
     }
+    Value* IArray::emit_word(Value* Data, Value* Off, Value*& Bit) {
+
+        auto& B = Parser::Builder;
+
+        //a packed element is addressed by its word and a bit in it
+        Bit = B.CreateAnd(Off, B.getInt64(kWordBits - 1));
+        auto Words = B.CreatePointerCast(Data, PointerType::getUnqual(B.getInt64Ty()));
+
+        return B.CreateGEP(B.getInt64Ty(), Words,
+            B.CreateLShr(Off, B.getInt64(Log2_64(kWordBits))));
+    }
+    Type* IArray::get_storage(Type* E) {
+
+        //bits are packed into words; the vector type keeps such
+        //parameters apart from plain i64 ones
+        if(E->isIntegerTy(1))
+            return FixedVectorType::get(E, kWordBits);
+
+        return E;
+    }
 
     Array::Array(std::unique_ptr<lexer::Token> t, Value* V, size_t u, Align a) 
         : Id{ std::move(t), V }, align_{ a } {}
     std::shared_ptr<Array> Array::get_array(
-        std::unique_ptr<lexer::Token> t, IndexList L) {
+        std::unique_ptr<lexer::Token> t, IndexList L, Type* E) {
 
         size_t sz = L.size();
         Type* T = ArrayType::get(
-                    Parser::Builder.getDoubleTy(), L.pop_back_val());
+                    E ? E : Parser::Builder.getDoubleTy(), L.pop_back_val());
 
         while(L.size()) {
 
             T = ArrayType::get(T, L.pop_back_val());
         }
 
-        auto V = Parser::Builder.CreateAlloca(T, nullptr);
+        auto V = emit_alloca(T);
         auto A = V->getAlign();
         std::string name = static_cast<Word*>(t.get())->lexeme_;
 
@@ -76,18 +263,417 @@ namespace llvmc::inter {
     }
     Type* Array::get_type() const {
 
+        if(table_) return table_;
+
         return cast<AllocaInst>(get_val())->getAllocatedType();
     }
     Align Array::get_align() const {
 
         return align_;
     }
+    Type* Array::get_elem() const {
+
+        auto T = get_type();
+        while(T->isArrayTy()) T = T->getArrayElementType();
+
+        return T;
+    }
+    size_t Array::get_rank() const {
+
+        size_t rank = 0;
+        for(auto T = get_type(); T->isArrayTy(); T = T->getArrayElementType())
+            ++rank;
+
+        return rank;
+    }
+    Value* Array::get_data() {
+
+        return Parser::Builder.CreatePointerCast(compile(),
+            PointerType::getUnqual(get_elem()));
+    }
+    void Array::get_dims(ValList& dims) const {
+
+        for(auto T = get_type(); T->isArrayTy(); T = T->getArrayElementType())
+            dims.push_back(Parser::Builder.getInt64(T->getArrayNumElements()));
+    }
+    Value* Array::emit_element(ValList idxs) {
+
+        auto T = get_type();
+        if(idxs.size() != get_rank())
+            return Parser::LogErrorV("invalid index");
+
+        idxs.insert(idxs.begin(), Parser::Builder.getInt64(0));
+        if(!GetElementPtrInst::getIndexedType(T, idxs))
+            return Parser::LogErrorV("invalid index");
+
+        return Parser::Builder.CreateGEP(T, compile(), idxs);
+    }
+    void Array::add_write() {
+
+        ++writes_;
+    }
+    bool Array::is_readonly() const {
+
+        //stored to once and not yet read: the initializer is all it holds
+        return writes_ == 1 && isa<AllocaInst>(get_val()) && get_val()->use_empty();
+    }
+    void Array::set_constant(Constant* V, Type* T) {
+
+        auto G = cast<GlobalVariable>(V->stripPointerCasts());
+        if(G->getAlign().valueOrOne() < align_) G->setAlignment(align_);
+
+        cast<AllocaInst>(get_val())->eraseFromParent();
+        set_val(V);
+        table_ = T;
+    }
+
+    ArrayRef::ArrayRef(std::unique_ptr<lexer::Token> t,
+        Value* V, ValList dims, Type* E)
+        : Array{ std::move(t), V, dims.size(), Parser::layout.getABITypeAlign(E) },
+        dims_{ std::move(dims) }, elem_{ E } {}
+    std::shared_ptr<ArrayRef> ArrayRef::get_ref(std::unique_ptr<lexer::Token> t,
+        Value* V, ValList dims, Type* E) {
+
+        std::string name = static_cast<Word*>(t.get())->lexeme_;
+
+        if(Parser::top->get_current(name)) 
+            return Parser::LogErrorV("redefinition of \'" + name + '\'');
+
+        auto sp = std::shared_ptr<ArrayRef>{
+            new ArrayRef{ std::move(t), V, std::move(dims), E } };
+        Parser::top->insert(name, sp);
+
+        return sp;
+    }
+    void ArrayRef::bind(Value* V, ValList dims) {
+
+        set_val(V);
+        dims_ = std::move(dims);
+    }
+    Type* ArrayRef::get_type() const {
+
+        //the shape is only known at run time
+        return nullptr;
+    }
+    Type* ArrayRef::get_elem() const {
+
+        return elem_;
+    }
+    size_t ArrayRef::get_rank() const {
+
+        return dims_.size();
+    }
+    Value* ArrayRef::get_data() {
+
+        return compile();
+    }
+    void ArrayRef::get_dims(ValList& dims) const {
+
+        dims.append(dims_.begin(), dims_.end());
+    }
+    Value* ArrayRef::emit_offset(ValList idxs) {
+
+        if(idxs.size() != get_rank())
+            return Parser::LogErrorV("invalid index");
+
+        //row-major offset of the element in the caller's storage
+        Value* Off = idxs[0];
+        for(size_t i = 1, sz = idxs.size(); i < sz; i++)
+            Off = Parser::Builder.CreateAdd(
+                Parser::Builder.CreateMul(Off, dims_[i]), idxs[i]);
+
+        return Off;
+    }
+    Value* ArrayRef::emit_element(ValList idxs) {
+
+        auto Off = emit_offset(std::move(idxs));
+        if(!Off) return nullptr;
+
+        return Parser::Builder.CreateGEP(elem_, compile(), Off);
+    }
+
+    DynArray::DynArray(std::unique_ptr<lexer::Token> t, Type* E)
+        : ArrayRef{ std::move(t), nullptr, {}, E } {}
+    std::shared_ptr<DynArray> DynArray::get_dyn(
+        std::unique_ptr<lexer::Token> t, Type* E) {
+
+        std::string name = static_cast<Word*>(t.get())->lexeme_;
+
+        if(Parser::top->get_current(name)) 
+            return Parser::LogErrorV("redefinition of \'" + name + '\'');
+
+        if(!E) E = Parser::Builder.getDoubleTy();
+        auto sp = std::shared_ptr<DynArray>{ new DynArray{ std::move(t), E } };
+        Parser::top->insert(name, sp);
+
+        return sp;
+    }
+    void DynArray::emit_free() {
+
+        for(auto [Slot, Release] : slots_)
+            Parser::Builder.CreateCall(Release, Parser::Builder.CreateLoad(
+                Parser::Builder.getInt8PtrTy(), Slot));
+
+        slots_.clear();
+    }
+    void DynArray::enter_scope(BranchInst* Br) {
+
+        scopes_.emplace_back(Br, false);
+    }
+    void DynArray::leave_scope() {
+
+        auto [Br, used] = scopes_.back();
+        scopes_.pop_back();
+        if(!used) return;
+
+        //the stack is marked where the scope is entered and reset every
+        //time control comes back round, which drops the last pass's arrays
+        auto& M = *Parser::Module;
+        auto Save = IRBuilder<>{ Br }.CreateCall(
+            Intrinsic::getDeclaration(&M, Intrinsic::stacksave));
+        auto Head = Br->getSuccessor(0);
+        IRBuilder<>{ Head, Head->getFirstInsertionPt() }.CreateCall(
+            Intrinsic::getDeclaration(&M, Intrinsic::stackrestore), Save);
+    }
+    Value* DynArray::emit_bytes(ValList const& dims) const {
+
+        auto& B = Parser::Builder;
+        auto Word = get_storage(get_elem());
+
+        Value* Bytes = B.getInt64(1);
+        for(auto D : dims) Bytes = B.CreateMul(Bytes, D);
+        if(get_elem()->isIntegerTy(1))
+            Bytes = B.CreateLShr(B.CreateAdd(Bytes,
+                B.getInt64(kWordBits - 1)), B.getInt64(Log2_64(kWordBits)));
+
+        return B.CreateMul(Bytes,
+            B.getInt64(Parser::layout.getTypeAllocSize(Word)));
+    }
+    AllocaInst* DynArray::emit_slot(Function* Release) const {
+
+        auto& B = Parser::Builder;
+        auto I8Ptr = B.getInt8PtrTy();
+
+        //the slot remembers what this declaration site owns
+        auto Slot = emit_alloca(I8Ptr);
+        IRBuilder<>{ Slot->getNextNode() }.CreateStore(
+            ConstantPointerNull::get(I8Ptr), Slot);
+        slots_.emplace_back(Slot, Release);
+
+        //re-running a declaration means its previous instance went out of scope
+        B.CreateCall(Release, B.CreateLoad(I8Ptr, Slot));
+
+        return Slot;
+    }
+    Value* DynArray::emit_alloc(ValList dims) {
+
+        auto& B = Parser::Builder;
+        auto I8Ptr = B.getInt8PtrTy();
+
+        bool bits = get_elem()->isIntegerTy(1);
+        auto Word = get_storage(get_elem());
+        auto Bytes = emit_bytes(dims);
+
+        //small instances take exactly their size on the stack,
+        //the rest go on the heap
+        auto Slot = emit_slot(Parser::Module->getFunction("free"));
+
+        auto F = B.GetInsertBlock()->getParent();
+        auto StackBB = BasicBlock::Create(Parser::Context, "", F);
+        auto HeapBB = BasicBlock::Create(Parser::Context, "", F);
+        auto JoinBB = BasicBlock::Create(Parser::Context, "", F);
+
+        B.CreateCondBr(B.CreateICmpULE(Bytes, B.getInt64(kStackSize)),
+            StackBB, HeapBB);
+
+        B.SetInsertPoint(StackBB);
+        auto Buf = B.CreateAlloca(B.getInt8Ty(), Bytes);
+        Buf->setAlignment(Align(kCacheLine));
+        for(auto& scope : scopes_) scope.second = true;
+        B.CreateBr(JoinBB);
+
+        B.SetInsertPoint(HeapBB);
+        auto Heap = B.CreateCall(Parser::Module->getFunction("llvmc.alloc"), Bytes);
+        B.CreateBr(JoinBB);
+
+        B.SetInsertPoint(JoinBB);
+        auto Data = B.CreatePHI(I8Ptr, 2);
+        Data->addIncoming(Buf, StackBB);
+        Data->addIncoming(Heap, HeapBB);
+        auto Owned = B.CreatePHI(I8Ptr, 2);
+        Owned->addIncoming(ConstantPointerNull::get(I8Ptr), StackBB);
+        Owned->addIncoming(Heap, HeapBB);
+        B.CreateStore(Owned, Slot);
+
+        //bit sets start out empty
+        if(bits) B.CreateMemSet(Data, B.getInt8(0), Bytes, Align(kCacheLine));
+
+        bind(B.CreatePointerCast(Data, PointerType::getUnqual(Word)),
+            std::move(dims));
+
+        return get_val();
+    }
+
+    MappedArray::MappedArray(std::unique_ptr<lexer::Token> t, Type* E,
+        std::string path, bool shared)
+        : DynArray{ std::move(t), E }, path_{ std::move(path) }, shared_{ shared } {}
+    std::shared_ptr<MappedArray> MappedArray::get_mapped(
+        std::unique_ptr<lexer::Token> t, Type* E, std::string path, bool shared) {
+
+        std::string name = static_cast<Word*>(t.get())->lexeme_;
+
+        if(Parser::top->get_current(name)) 
+            return Parser::LogErrorV("redefinition of \'" + name + '\'');
+
+        auto sp = std::shared_ptr<MappedArray>{
+            new MappedArray{ std::move(t), E, std::move(path), shared } };
+        Parser::top->insert(name, sp);
+
+        return sp;
+    }
+    void MappedArray::set_random() {
+
+        random_ = true;
+    }
+    Value* MappedArray::emit_alloc(ValList dims) {
+
+        auto& B = Parser::Builder;
+        auto I8Ptr = B.getInt8PtrTy();
+        auto& M = *Parser::Module;
+
+        auto Map = M.getOrInsertFunction("llvmc_map", FunctionType::get(
+            I8Ptr, { I8Ptr, B.getInt64Ty(), B.getInt32Ty() }, false));
+        auto Unmap = cast<Function>(M.getOrInsertFunction("llvmc_unmap",
+            FunctionType::get(B.getVoidTy(), { I8Ptr }, false)).getCallee());
+
+        //the file is paged in on first touch; a private mapping keeps
+        //the writes in memory, a shared one sends them back to the file
+        auto Slot = emit_slot(Unmap);
+        int32_t flags = (shared_ ? LLVMC_MAP_SHARED : 0)
+            | (random_ ? LLVMC_MAP_RANDOM : 0);
+        auto Data = B.CreateCall(Map, { B.CreateGlobalStringPtr(path_),
+            emit_bytes(dims), B.getInt32(flags) });
+        B.CreateStore(Data, Slot);
+
+        bind(B.CreatePointerCast(Data, PointerType::getUnqual(
+            get_storage(get_elem()))), std::move(dims));
+
+        return get_val();
+    }
 
     Op::Op(std::unique_ptr<Token> t) noexcept : Expr{ std::move(t) } {}
 
     Arith::Arith(std::unique_ptr<Token> t, std::unique_ptr<Expr> e1,
         std::unique_ptr<Expr> e2) noexcept : Op{ std::move(t) },
         lhs_{ std::move(e1) }, rhs_{ std::move(e2) } {}
+    bool Arith::is_step(Expr const* E) {
+
+        auto C = dynamic_cast<FConstant const*>(E);
+        if(!C || !C->is_integral()) return false;
+
+        double v = *static_cast<Num const*>(C->op_.get());
+
+        return std::abs(v) <= kMaxStep;
+    }
+    bool Arith::is_integral() const {
+
+        //only a step by a small literal keeps a variable in i64: it can't
+        //leave the i64 range in any feasible run, whereas products and sums
+        //of variables can, and must then round like doubles instead of wrap
+        return lhs_ && rhs_ && (*op_ == Tag{'+'} || *op_ == Tag{'-'})
+            && lhs_->is_integral() && rhs_->is_integral()
+            && (is_step(lhs_.get()) || is_step(rhs_.get()));
+    }
+    bool Arith::has_array() const {
+
+        return (lhs_ && lhs_->has_array()) || (rhs_ && rhs_->has_array());
+    }
+    bool Arith::is_indirect() const {
+
+        return (lhs_ && lhs_->is_indirect()) || (rhs_ && rhs_->is_indirect());
+    }
+    Value* Arith::emit(Value* L, Value* R, bool wrap) const {
+
+        L = Expr::to_integer(L);
+        R = Expr::to_integer(R);
+
+        if(L->getType()->isIntegerTy(64) && R->getType()->isIntegerTy(64)
+            && *op_ != Tag{'/'}) {
+
+            auto& B = Parser::Builder;
+            if(wrap) {
+
+                switch(*op_) {
+
+                    case Tag{'+'}:
+                        return B.CreateAdd(L, R);
+                    case Tag{'-'}:
+                        return B.CreateSub(L, R);
+                    case Tag{'*'}:
+                        return B.CreateMul(L, R);
+                }
+            }
+
+            //exact in i64 as long as it fits, otherwise done in double
+            //as if the operands had never been integral; the builder
+            //doesn't fold the intrinsics, so constants are folded here
+            auto CL = dyn_cast<ConstantInt>(L);
+            auto CR = dyn_cast<ConstantInt>(R);
+            if(CL && CR) {
+
+                bool overflow;
+                auto& X = CL->getValue();
+                auto& Y = CR->getValue();
+                auto V = *op_ == Tag{'+'} ? X.sadd_ov(Y, overflow)
+                    : *op_ == Tag{'-'} ? X.ssub_ov(Y, overflow)
+                    : X.smul_ov(Y, overflow);
+                if(!overflow)
+                    return ConstantFP::get(B.getDoubleTy(),
+                        static_cast<double>(V.getSExtValue()));
+
+                return emit(Expr::to_double(L), Expr::to_double(R), false);
+            }
+
+            auto ID = *op_ == Tag{'+'} ? Intrinsic::sadd_with_overflow
+                : *op_ == Tag{'-'} ? Intrinsic::ssub_with_overflow
+                : Intrinsic::smul_with_overflow;
+            auto Res = B.CreateBinaryIntrinsic(ID, L, R);
+
+            return B.CreateSelect(B.CreateExtractValue(Res, 1),
+                emit(Expr::to_double(L), Expr::to_double(R), false),
+                B.CreateSIToFP(B.CreateExtractValue(Res, 0), B.getDoubleTy()));
+        }
+
+        L = Expr::to_double(L);
+        R = Expr::to_double(R);
+
+        switch(*op_) {
+            
+            case Tag{'+'}:
+                return Parser::Builder.CreateFAdd(L, R);
+            case Tag{'-'}:
+                return Parser::Builder.CreateFSub(L, R);
+            case Tag{'*'}:
+                return Parser::Builder.CreateFMul(L, R);
+            case Tag{'/'}:
+                return Parser::Builder.CreateFDiv(L, R);
+        }
+
+        return Parser::LogErrorV("invalid operand type");
+    }
+    Value* Arith::emit_lane(Value* I) {
+
+        if(!has_array()) return Expr::emit_lane(I);
+        if(!lhs_ || !rhs_) return nullptr;
+
+        Value* L = lhs_->emit_lane(I);
+        Value* R = rhs_->emit_lane(I);
+
+        if(!I || !L || !R) return nullptr;
+
+        //elements of integer arrays wrap like their storage does
+        return emit(L, R, true);
+    }
     Value* Arith::compile() {
         
         if(!IArray::is_array(lhs_.get()) && !IArray::is_array(rhs_.get())) {
@@ -99,17 +685,7 @@ namespace llvmc::inter {
 
             if(!L || !R) return nullptr;
 
-            switch(*op_) {
-                
-                case Tag{'+'}:
-                    return Parser::Builder.CreateFAdd(L, R);
-                case Tag{'-'}:
-                    return Parser::Builder.CreateFSub(L, R);
-                case Tag{'*'}:
-                    return Parser::Builder.CreateFMul(L, R);
-                case Tag{'/'}:
-                    return Parser::Builder.CreateFDiv(L, R);
-            }
+            return emit(L, R, is_integral());
         }
         
         return Parser::LogErrorV("invalid operand type");
@@ -117,263 +693,911 @@ namespace llvmc::inter {
 
     Unary::Unary(std::unique_ptr<Token> t, std::unique_ptr<Expr> e) noexcept
         : Op{ std::move(t) }, exp_{ std::move(e) } {}
+    bool Unary::is_integral() const {
+
+        return exp_ && exp_->is_integral();
+    }
+    bool Unary::has_array() const {
+
+        return exp_ && exp_->has_array();
+    }
+    bool Unary::is_indirect() const {
+
+        return exp_ && exp_->is_indirect();
+    }
+    Value* Unary::emit(Value* E) const {
+
+        E = Expr::to_integer(E);
+
+        if(E->getType()->isIntegerTy(64))
+            return Parser::Builder.CreateNeg(E);
+
+        return Parser::Builder.CreateFNeg(E);
+    }
+    Value* Unary::emit_lane(Value* I) {
+
+        if(!has_array()) return Expr::emit_lane(I);
+
+        Value* E = exp_->emit_lane(I);
+
+        if(!I || !E) return nullptr;
+
+        return emit(E);
+    }
     Value* Unary::compile() {
 
-        if(!IArray::is_array(exp_.get())) {
-            
-            if(!exp_) return nullptr;
+        if(!IArray::is_array(exp_.get())) {
+            
+            if(!exp_) return nullptr;
+
+            Value* E = exp_->compile();
+
+            if(!E) return nullptr;
+
+            return emit(E);
+        }
+
+        return Parser::LogErrorV("invalid operand type");
+    }
+
+    Access::Access(std::shared_ptr<Id> id, ArrList vec) : Op{ nullptr }, 
+        arr_{ std::move(id) }, args_{ std::move(vec) }, bit_{ nullptr } {
+
+        //the whole body is parsed before the declaration is compiled,
+        //so the mapping's access hint is settled by then
+        auto M = dynamic_cast<MappedArray*>(arr_.get());
+        if(M && std::any_of(args_.begin(), args_.end(),
+            [](auto const& el) { return el && el->is_indirect(); }))
+            M->set_random();
+    }
+    Array* Access::get_array() const {
+
+        return dynamic_cast<Array*>(arr_.get());
+    }
+    Type* Access::get_elem() const {
+
+        if(auto A = dynamic_cast<Array const*>(arr_.get()))
+            return A->get_elem();
+
+        return nullptr;
+    }
+    Value* Access::get_bit() const {
+
+        return bit_;
+    }
+    bool Access::is_integral() const {
+
+        auto T = get_elem();
+
+        return T && T->isIntegerTy();
+    }
+    Value* Access::compile() {
+        
+        if(auto A = dynamic_cast<Array*>(arr_.get())) {
+
+            ValList args;
+            
+            try {
+
+                std::transform(args_.begin(), args_.end(), std::back_inserter(args),
+                [](auto const& el) {
+
+                    if(!el) throw std::runtime_error{ "invalid index" };
+                    
+                    auto V = el->compile();
+                    if(!V)
+                        throw std::runtime_error{ "invalid index" };
+
+                    return Expr::to_index(V);
+                });
+            }
+            catch(std::exception& e) {
+                
+                return Parser::LogErrorV(e.what());
+            }
+
+            if(auto R = dynamic_cast<ArrayRef*>(A); R && R->get_elem()->isIntegerTy(1)) {
+
+                auto Off = R->emit_offset(std::move(args));
+                if(!Off) return nullptr;
+
+                return IArray::emit_word(R->compile(), Off, bit_);
+            }
+
+            return A->emit_element(std::move(args));
+        }
+
+        return Parser::LogErrorV("trying to access non-array id");
+    }
+
+    Load::Load(std::shared_ptr<Expr> e) noexcept 
+        : Op{ nullptr }, acc_{ std::move(e) } {}
+    bool Load::is_integral() const {
+
+        return acc_ && acc_->is_integral();
+    }
+    bool Load::is_indirect() const {
+
+        //an element read from memory, as in A[B[i]]
+        return dynamic_cast<Access const*>(acc_.get());
+    }
+    Value* Load::compile() {
+
+        if(!acc_) return nullptr;
+
+        auto V = acc_->compile();
+        if(!V) return nullptr;
+
+        if(auto A = dynamic_cast<Access const*>(acc_.get())) {
+
+            auto& B = Parser::Builder;
+            if(auto Bit = A->get_bit())
+                return B.CreateTrunc(B.CreateLShr(
+                    B.CreateLoad(B.getInt64Ty(), V), Bit), B.getInt1Ty());
+
+            return Expr::from_elem(B.CreateLoad(A->get_elem(), V));
+        }
+
+        return Parser::Builder.CreateLoad(scalar_type(acc_->is_integral()), V);
+    }
+
+    ArrayLoad::ArrayLoad(std::shared_ptr<Id> e) noexcept
+        : Op{ nullptr }, acc_{ std::static_pointer_cast<Array>(std::move(e)) } {}
+    Array* ArrayLoad::get_array() const {
+
+        return acc_.get();
+    }
+    Value* ArrayLoad::emit_lane(Value* I) {
+
+        auto& B = Parser::Builder;
+        auto E = acc_->get_elem();
+
+        if(!I) return lanes_[this] = acc_->get_data();
+
+        //lane I is the I-th element in row-major order
+        if(E->isIntegerTy(1)) {
+
+            Value* Bit = nullptr;
+            auto W = IArray::emit_word(lanes_[this], I, Bit);
+
+            return B.CreateTrunc(B.CreateLShr(
+                B.CreateLoad(B.getInt64Ty(), W), Bit), B.getInt1Ty());
+        }
+
+        return Expr::from_elem(B.CreateLoad(E, B.CreateGEP(E, lanes_[this], I)));
+    }
+    Value* ArrayLoad::compile() {
+
+        if(!acc_) return nullptr;
+
+        return acc_->compile();
+    }
+    Type* ArrayLoad::get_type() const {
+
+        return acc_->get_type();
+    }
+    Align ArrayLoad::get_align() const {
+
+        return acc_->get_align();
+    }
+
+    ArrayAlloc::ArrayAlloc(std::shared_ptr<DynArray> a, ArrList dims)
+        : Op{ nullptr }, arr_{ std::move(a) }, dims_{ std::move(dims) } {}
+    Value* ArrayAlloc::compile() {
+
+        if(!arr_) return nullptr;
+
+        ValList dims;
+        for(auto const& D : dims_) {
+
+            if(!D) return nullptr;
+
+            auto V = D->compile();
+            if(!V) return nullptr;
+
+            dims.push_back(Expr::to_index(V));
+        }
+
+        return arr_->emit_alloc(std::move(dims));
+    }
+
+    Store::Store(std::shared_ptr<Expr> e, std::unique_ptr<Expr> s)
+        : Op{ nullptr }, acc_{ std::move(e) }, val_{ std::move(s) } {
+
+        if(auto id = dynamic_cast<Id*>(acc_.get()); id && !IArray::is_array(id))
+            id->add_def(val_.get());
+
+        if(auto A = dynamic_cast<Array*>(acc_.get())) A->add_write();
+        else if(auto Acc = dynamic_cast<Access*>(acc_.get()); Acc && Acc->get_array())
+            Acc->get_array()->add_write();
+    }
+    void Store::emit_element(Value* Ptr, Value* Bit, Type* E, Value* Val) {
+
+        auto& B = Parser::Builder;
+
+        if(Bit) {
+
+            //read-modify-write of the word holding the bit
+            auto W = B.CreateLoad(B.getInt64Ty(), Ptr);
+            auto Mask = B.CreateShl(B.getInt64(1), Bit);
+            auto Set = B.CreateShl(
+                B.CreateZExt(Expr::to_cond(Val), B.getInt64Ty()), Bit);
+            Val = B.CreateOr(B.CreateAnd(W, B.CreateNot(Mask)), Set);
+        }
+        else
+            Val = Expr::to_elem(Val, E);
+
+        B.CreateStore(Val, Ptr);
+    }
+    Value* Store::emit_lanes(Array* A) {
+
+        auto& B = Parser::Builder;
+        auto E = A->get_elem();
+        bool bits = E->isIntegerTy(1);
+
+        ValList dims;
+        A->get_dims(dims);
+
+        //operands are evaluated and their shapes checked once, up front
+        lanes_.clear();
+        val_->emit_lane(nullptr);
+
+        for(auto [Leaf, V] : lanes_) {
+
+            if(!V) return nullptr;
+            if(!IArray::is_array(Leaf)) continue;
+
+            auto L = dynamic_cast<ArrayLoad const*>(Leaf);
+            if(!L) return Parser::LogErrorV("invalid operand type");
+
+            ValList op_dims;
+            L->get_array()->get_dims(op_dims);
+            if(op_dims.size() != dims.size())
+                return Parser::LogErrorV("incompatible array shapes");
+
+            //run-time extents go unchecked, like indices do
+            for(size_t i = 0, sz = dims.size(); i < sz; i++) {
+
+                auto C1 = dyn_cast<ConstantInt>(dims[i]);
+                auto C2 = dyn_cast<ConstantInt>(op_dims[i]);
+                if(C1 && C2 && C1->getZExtValue() != C2->getZExtValue())
+                    return Parser::LogErrorV("incompatible array shapes");
+            }
+        }
+
+        Value* Count = B.getInt64(1);
+        for(auto D : dims) Count = B.CreateMul(Count, D);
+        auto Data = A->get_data();
+
+        auto F = B.GetInsertBlock()->getParent();
+        auto PreBB = B.GetInsertBlock();
+        auto HeadBB = BasicBlock::Create(Parser::Context, "", F);
+        auto BodyBB = BasicBlock::Create(Parser::Context, "", F);
+        auto ExitBB = BasicBlock::Create(Parser::Context, "", F);
+        B.CreateBr(HeadBB);
+
+        B.SetInsertPoint(HeadBB);
+        auto I = B.CreatePHI(B.getInt64Ty(), 2);
+        I->addIncoming(B.getInt64(0), PreBB);
+        B.CreateCondBr(B.CreateICmpULT(I, Count), BodyBB, ExitBB);
+
+        //the whole expression is fused into a single pass over the elements
+        B.SetInsertPoint(BodyBB);
+        auto V = val_->emit_lane(I);
+        if(!V) return nullptr;
+
+        Value* Bit = nullptr;
+        auto Ptr = bits ? IArray::emit_word(Data, I, Bit) : B.CreateGEP(E, Data, I);
+        emit_element(Ptr, Bit, E, V);
+        I->addIncoming(B.CreateAdd(I, B.getInt64(1)), BodyBB);
+        auto Latch = B.CreateBr(HeadBB);
+
+        //lane i only touches element i of each array, so the lanes are
+        //independent unless neighbours share a packed word
+        if(!bits) {
+
+            auto Group = MDNode::getDistinct(Parser::Context, {});
+            for(auto& Inst : *BodyBB)
+                if(Inst.mayReadOrWriteMemory())
+                    Inst.setMetadata(LLVMContext::MD_access_group, Group);
+
+            auto Loop = MDNode::getDistinct(Parser::Context, { nullptr,
+                MDNode::get(Parser::Context, { MDString::get(Parser::Context,
+                    "llvm.loop.parallel_accesses"), Group }) });
+            Loop->replaceOperandWith(0, Loop);
+            Latch->setMetadata(LLVMContext::MD_loop, Loop);
+        }
+
+        B.SetInsertPoint(ExitBB);
+        lanes_.clear();
+
+        return Data;
+    }
+    Value* Store::compile() {
+
+        if(!acc_ || !val_) return nullptr;
+
+        //a constant initializer takes the element type of its target
+        auto T = dynamic_cast<Array*>(acc_.get());
+        auto C = dynamic_cast<ArrayConstant*>(val_.get());
+        if(C && T && T->get_type())
+            C->cast_to(T->get_elem());
+
+        //a table that is never written again is read in place, with
+        //neither a stack copy nor a memcpy on every call
+        if(C && T && T->get_type() && T->get_type() == C->get_type()
+            && T->is_readonly()) {
+
+            auto V = cast<Constant>(C->compile());
+            T->set_constant(V, C->get_type());
+
+            return V;
+        }
+
+        //only such tables may outgrow the stack
+        if(T && T->get_type()
+            && Parser::layout.getTypeAllocSize(T->get_type()) > IArray::kStackSize)
+            return Parser::LogErrorV("array of this size can't have an initializer");
+
+        //an array assigned anything but a same-shaped static copy or a
+        //constant is filled element by element, broadcasting scalars
+        auto L = dynamic_cast<ArrayLoad const*>(val_.get());
+        bool copy = L && T && T->get_type() && T->get_type() == L->get_type();
+        if(T && !copy && (L || !IArray::is_array(val_.get())))
+            return emit_lanes(T);
+
+        Value* Acc = acc_->compile();
+        Value* Val = val_->compile();
+
+        if(!Acc || !Val) return nullptr;
+
+        if(!IArray::is_array(acc_.get()) && !IArray::is_array(val_.get())){
+    
+            if(auto A = dynamic_cast<Access const*>(acc_.get()))
+                emit_element(Acc, A->get_bit(), A->get_elem(), Val);
+            else
+                Parser::Builder.CreateStore(acc_->is_integral()
+                    ? Expr::to_integer(Val) : Expr::to_double(Val), Acc);
+        }
+        else {
+
+            auto a_Acc = dynamic_cast<IArray const*>(acc_.get());
+            auto a_Val = dynamic_cast<IArray const*>(val_.get());
+            
+            if(a_Acc && a_Val) {
+
+                if(auto T = a_Val->get_type(); T && T == a_Acc->get_type()) {
+
+                    Parser::Builder.CreateMemCpy(
+                        Acc, a_Acc->get_align(),
+                        Val, a_Val->get_align(),
+                        Parser::layout.getTypeSizeInBits(T) / IArray::kByteSize);
+                }
+                else    
+                    return Parser::LogErrorV("incompatible array types");
+
+            }
+            else
+                return Parser::LogErrorV("incompatible types");
+        }
+
+        return Acc;
+    }
+
+    Call::Call(std::unique_ptr<Token> t, ArrList lst) 
+        : Op{ std::move(t) }, name_{ static_cast<Word const*>(op_.get())->lexeme_ },
+        args_{ std::move(lst) }, saved_{ Lexer::line_ }, tail_{ false } {
+
+        //arrays go by reference, so any callee may write them except
+        //the builtins that only read their operands
+        bool builtin = !Parser::Module->getFunction(name_);
+        auto set = bits::Routine::get_kind(name_);
+        bool reads = builtin && (reduce::Reducer::get_kind(name_)
+            || (set && *set != bits::Kind::Clear));
+        bool target = builtin && linalg::Kernel::get_kind(name_);
+
+        for(auto const& arg : args_) {
+
+            auto L = dynamic_cast<ArrayLoad const*>(arg.get());
+            if(L && !reads && (!target || &arg == &args_.front()))
+                L->get_array()->add_write();
+        }
+    }
+    class Call::LineGuard {
+
+        unsigned saved_;
+
+    public:
+
+        LineGuard() {
+
+            saved_ = Lexer::line_;
+        }
+        ~LineGuard() {
+
+            Lexer::line_ = saved_;
+        }
+    };
+    Function* Call::callee() const {
+
+        return Parser::Module->getFunction(name_);
+    }
+    bool Call::is_indirect() const {
+
+        return true;
+    }
+    void Call::set_tail() {
+
+        tail_ = true;
+    }
+    bool Call::emit_args(Function* Calee, ValList& ArgsV) const {
+
+        //an array parameter is a pointer followed by one i64 per dimension
+        size_t par_sz = std::count_if(Calee->arg_begin(), Calee->arg_end(),
+            [](auto& A) { return !A.getType()->isIntegerTy(64); });
+        size_t arg_sz = args_.size();
+        if(par_sz != arg_sz) {
+
+            Parser::LogErrorV("wrong arguments number: expected "
+            + std::to_string(par_sz) + ", but " 
+            + std::to_string(arg_sz) + " provided");
+            return false;
+        }
+
+        auto P = Calee->arg_begin();
+
+        for(auto const& el : args_) {
+
+            if(!el) return false;
+
+            if(!P->getType()->isPointerTy()) {
+
+                if(el->has_array()) {
+
+                    Parser::LogErrorV("incompatible array types");
+                    return false;
+                }
+
+                auto V = el->compile();
+                if(!V) return false;
+
+                ArgsV.push_back(Expr::to_double(V));
+                ++P;
+                continue;
+            }
+
+            //arrays are passed in place, never copied
+            size_t rank = 0;
+            for(auto Q = P + 1; Q != Calee->arg_end() 
+                && Q->getType()->isIntegerTy(64); ++Q) ++rank;
+
+            auto AL = dynamic_cast<ArrayLoad const*>(el.get());
+            auto A = AL ? AL->get_array() : nullptr;
+            if(!A || A->get_rank() != rank || P->getType()
+                != PointerType::getUnqual(IArray::get_storage(A->get_elem()))) {
+
+                Parser::LogErrorV("incompatible array types");
+                return false;
+            }
+
+            ArgsV.push_back(A->get_data());
+            A->get_dims(ArgsV);
+            P += rank + 1;
+        }
+
+        return true;
+    }
+    Value* Call::emit_reduce(reduce::Kind K) const {
+
+        auto& B = Parser::Builder;
+        size_t par_sz = reduce::Reducer::get_arity(K);
+        size_t arg_sz = args_.size();
+        if(par_sz != arg_sz)
+            return Parser::LogErrorV("wrong arguments number: expected "
+                + std::to_string(par_sz) + ", but " 
+                + std::to_string(arg_sz) + " provided");
+
+        ValList ArgsV;
+        TypeList elems;
+        Value* Count = nullptr;
+
+        for(auto const& el : args_) {
+
+            auto AL = dynamic_cast<ArrayLoad const*>(el.get());
+            auto A = AL ? AL->get_array() : nullptr;
+            if(!A || A->get_elem()->isIntegerTy(1))
+                return Parser::LogErrorV("incompatible array types");
 
-            Value* E = exp_->compile();
+            //any shape is reduced as the flat sequence of its elements
+            ValList dims;
+            A->get_dims(dims);
+            Value* N = B.getInt64(1);
+            for(auto D : dims) N = B.CreateMul(N, D);
 
-            if(!E) return nullptr;
+            if(Count && isa<ConstantInt>(Count) && isa<ConstantInt>(N) && Count != N)
+                return Parser::LogErrorV("incompatible array shapes");
+            if(!Count) Count = N;
 
-            return Parser::Builder.CreateFNeg(E);
+            ArgsV.push_back(A->get_data());
+            elems.push_back(A->get_elem());
         }
+        ArgsV.push_back(Count);
 
-        return Parser::LogErrorV("invalid operand type");
+        return B.CreateCall(reduce::Reducer{ K }.get(*Parser::Module, elems), ArgsV);
     }
+    Value* Call::emit_sort() const {
 
-    Access::Access(std::shared_ptr<Id> id, ArrList vec) : Op{ nullptr }, 
-        arr_{ std::move(id) }, args_{ std::move(vec) } {}
-    Value* Access::compile() {
-        
-        if(arr_) {
+        auto& B = Parser::Builder;
+        size_t arg_sz = args_.size();
+        if(arg_sz != 1 && arg_sz != 3)
+            return Parser::LogErrorV("wrong arguments number: expected 1 or 3, but "
+                + std::to_string(arg_sz) + " provided");
 
-            ValList args{ Parser::Builder.getInt32(0) };
-            Value* arr;
-            
-            try {
+        auto AL = dynamic_cast<ArrayLoad const*>(args_[0].get());
+        auto A = AL ? AL->get_array() : nullptr;
+        if(!A || A->get_elem()->isIntegerTy(1))
+            return Parser::LogErrorV("incompatible array types");
 
-                std::transform(args_.begin(), args_.end(), std::back_inserter(args),
-                [](auto const& el) {
+        //the elements are sorted in row-major order, whatever the shape
+        ValList dims;
+        A->get_dims(dims);
+        Value* N = B.getInt64(1);
+        for(auto D : dims) N = B.CreateMul(N, D);
 
-                    if(!el) throw std::runtime_error{ "invalid index" };
-                    
-                    auto V = el->compile();
-                    if(!V)
-                        throw std::runtime_error{ "invalid index" };
+        ValList ArgsV{ A->get_data(), N, B.getInt64(0), N };
+        for(size_t i = 1; i < arg_sz; i++) {
 
-                    return Parser::Builder.CreateFPToUI(V, Parser::Builder.getInt32Ty());
-                });
+            if(!args_[i]) return nullptr;
 
-                arr = arr_->compile();
-                auto checkType = cast<AllocaInst>(arr)->getAllocatedType();
-                if(!GetElementPtrInst::getIndexedType(checkType, args))
-                    throw std::runtime_error{ "invalid index" };
-            }
-            catch(std::exception& e) {
-                
-                return Parser::LogErrorV(e.what());
-            }
+            auto V = args_[i]->compile();
+            if(!V) return nullptr;
 
-            return Parser::Builder.CreateGEP(arr, args);
+            //bounds keep their sign, the sorter clamps them to the array
+            ArgsV[i + 1] = V->getType()->isIntegerTy()
+                ? Expr::to_index(V) : B.CreateFPToSI(V, B.getInt64Ty());
         }
 
-        return Parser::LogErrorV("trying to access non-array id");
+        return B.CreateCall(sort::Sorter{ A->get_elem() }.get(*Parser::Module), ArgsV);
     }
+    Value* Call::emit_linalg(linalg::Kind K) const {
 
-    Load::Load(std::shared_ptr<Expr> e) noexcept 
-        : Op{ nullptr }, acc_{ std::move(e) } {}
-    Value* Load::compile() {
+        size_t par_sz = linalg::Kernel::get_arity(K);
+        size_t arg_sz = args_.size();
+        if(par_sz != arg_sz)
+            return Parser::LogErrorV("wrong arguments number: expected "
+                + std::to_string(par_sz) + ", but " 
+                + std::to_string(arg_sz) + " provided");
 
-        if(!acc_) return nullptr;
+        ValList ArgsV;
+        TypeList elems;
+        std::vector<Array*> arrs;
 
-        auto V = acc_->compile();
-        if(!V) return nullptr;
+        for(auto const& el : args_) {
 
-        return Parser::Builder.CreateLoad(V);
-    }
+            auto AL = dynamic_cast<ArrayLoad const*>(el.get());
+            auto A = AL ? AL->get_array() : nullptr;
+            if(!A || A->get_rank() != 2 || A->get_elem()->isIntegerTy(1))
+                return Parser::LogErrorV("incompatible array types");
 
-    ArrayLoad::ArrayLoad(std::shared_ptr<Id> e) noexcept
-        : Op{ nullptr }, acc_{ std::static_pointer_cast<Array>(std::move(e)) } {}
-    Value* ArrayLoad::compile() {
+            //the target is written while the operands are still read
+            if(!arrs.empty() && A == arrs.front())
+                return Parser::LogErrorV("target array passed as an operand");
 
-        if(!acc_) return nullptr;
+            arrs.push_back(A);
+            ArgsV.push_back(A->get_data());
+            A->get_dims(ArgsV);
+            elems.push_back(A->get_elem());
+        }
 
-        return acc_->compile();
-    }
-    Type* ArrayLoad::get_type() const {
+        //extents known at compile time must chain, the others are
+        //checked by the kernel, which stops the program on a mismatch
+        auto extent = [&](size_t a, unsigned d) -> uint64_t {
 
-        return acc_->get_type();
-    }
-    Align ArrayLoad::get_align() const {
+            auto T = arrs[a]->get_type();
+            if(!T) return 0;
+            if(d) T = T->getArrayElementType();
 
-        return acc_->get_align();
-    }
+            return T->getArrayNumElements();
+        };
+        auto differ = [&](size_t a, unsigned d, size_t b, unsigned e) {
 
-    Store::Store(std::shared_ptr<Expr> e, std::unique_ptr<Expr> s) noexcept
-        : Op{ nullptr }, acc_{ std::move(e) }, val_{ std::move(s) } {}
-    Value* Store::compile() {
+            auto X = extent(a, d), Y = extent(b, e);
+            return X && Y && X != Y;
+        };
 
-        if(!acc_ || !val_) return nullptr;
+        bool bad = K == linalg::Kind::MatMul
+            ? differ(0, 0, 1, 0) || differ(1, 1, 2, 0) || differ(0, 1, 2, 1)
+            : differ(0, 0, 1, 1) || differ(0, 1, 1, 0);
+        if(bad) return Parser::LogErrorV("incompatible array shapes");
 
-        Value* Acc = acc_->compile();
-        Value* Val = val_->compile();
+        return Parser::Builder.CreateCall(
+            linalg::Kernel{ K }.get(*Parser::Module, elems), ArgsV);
+    }
+    Value* Call::emit_read() const {
 
-        if(!Acc || !Val) return nullptr;
+        auto& B = Parser::Builder;
+        size_t par_sz = name_ == "readn" ? 2 : 1;
+        size_t arg_sz = args_.size();
+        if(par_sz != arg_sz)
+            return Parser::LogErrorV("wrong arguments number: expected "
+                + std::to_string(par_sz) + ", but " 
+                + std::to_string(arg_sz) + " provided");
 
-        if(!IArray::is_array(acc_.get()) && !IArray::is_array(val_.get())){
-    
-            Parser::Builder.CreateStore(Val, Acc);
-        }
-        else {
+        auto AL = dynamic_cast<ArrayLoad const*>(args_[0].get());
+        auto A = AL ? AL->get_array() : nullptr;
+        if(!A || A->get_elem()->isIntegerTy(1))
+            return Parser::LogErrorV("incompatible array types");
 
-            auto a_Acc = dynamic_cast<IArray const*>(acc_.get());
-            auto a_Val = dynamic_cast<IArray const*>(val_.get());
-            
-            if(a_Acc && a_Val) {
+        //the array is filled in row-major order, at most up to its end
+        ValList dims;
+        A->get_dims(dims);
+        Value* N = B.getInt64(1);
+        for(auto D : dims) N = B.CreateMul(N, D);
 
-                if(auto T = a_Val->get_type(); T == a_Acc->get_type()) {
+        if(par_sz > 1) {
 
-                    Parser::Builder.CreateMemCpy(
-                        Acc, a_Acc->get_align(),
-                        Val, a_Val->get_align(),
-                        Parser::layout.getTypeSizeInBits(T) / IArray::kByteSize);
-                }
-                else    
-                    return Parser::LogErrorV("incompatible array types");
+            if(!args_[1]) return nullptr;
 
-            }
-            else
-                return Parser::LogErrorV("incompatible types");
+            auto V = args_[1]->compile();
+            if(!V) return nullptr;
+
+            V = Expr::to_index(V);
+            N = B.CreateSelect(B.CreateICmpSLT(V, N), V, N);
         }
 
-        return Acc;
-    }
+        auto E = A->get_elem();
+        std::string name = "llvmc_read_";
+        names::append_type(name, E);
 
-    Call::Call(std::unique_ptr<Token> t, ArrList lst) 
-        : Op{ std::move(t) }, name_{ static_cast<Word const*>(op_.get())->lexeme_ },
-        args_{ std::move(lst) }, saved_{ Lexer::line_ } {}
-    class Call::LineGuard {
+        auto Reader = Parser::Module->getOrInsertFunction(name, FunctionType::get(
+            B.getDoubleTy(), { PointerType::getUnqual(E), B.getInt64Ty() }, false));
 
-        unsigned saved_;
+        return B.CreateCall(Reader, { A->get_data(), N });
+    }
+    Value* Call::emit_bits(bits::Kind K) const {
 
-    public:
+        auto& B = Parser::Builder;
+        size_t arg_sz = args_.size();
+        if(arg_sz != 1)
+            return Parser::LogErrorV("wrong arguments number: expected 1, but "
+                + std::to_string(arg_sz) + " provided");
 
-        LineGuard() {
+        auto AL = dynamic_cast<ArrayLoad const*>(args_[0].get());
+        auto A = AL ? AL->get_array() : nullptr;
+        if(!A || A->get_rank() != 1 || !A->get_elem()->isIntegerTy(1))
+            return Parser::LogErrorV("incompatible array types");
 
-            saved_ = Lexer::line_;
-        }
-        ~LineGuard() {
+        ValList ArgsV{ B.CreatePointerCast(A->get_data(),
+            PointerType::getUnqual(B.getInt64Ty())) };
+        A->get_dims(ArgsV);
 
-            Lexer::line_ = saved_;
-        }
-    };
+        return B.CreateCall(bits::Routine{ K }.get(*Parser::Module), ArgsV);
+    }
     Value* Call::compile() {
 
         LineGuard g{};
         Lexer::line_ = saved_;
 
-        auto Calee = Parser::Module->getFunction(name_);
+        auto Calee = callee();
+        //a function of the program shadows the builtin of the same name
+        if(auto K = reduce::Reducer::get_kind(name_); K && !Calee)
+            return emit_reduce(*K);
+        if(name_ == "sort" && !Calee)
+            return emit_sort();
+        if(auto K = linalg::Kernel::get_kind(name_); K && !Calee)
+            return emit_linalg(*K);
+        if((name_ == "read" || name_ == "readn") && !Calee)
+            return emit_read();
+        if(auto K = bits::Routine::get_kind(name_); K && !Calee)
+            return emit_bits(*K);
         if(!Calee) 
             return Parser::LogErrorV("unknown function referenced");
-        
-        size_t par_sz = Calee->arg_size();
-        size_t arg_sz = args_.size();
-        if(par_sz != arg_sz)
-            return Parser::LogErrorV("wrong arguments number: expected "
-            + std::to_string(par_sz) + ", but " 
-            + std::to_string(arg_sz) + " provided");
 
         ValList ArgsV;
+        if(!emit_args(Calee, ArgsV)) return nullptr;
 
-        try {
+        auto CI = Parser::Builder.CreateCall(Calee, ArgsV);
+        //a call in return position may reuse the frame unless it gets
+        //a pointer into the caller's one
+        if(tail_ && std::none_of(ArgsV.begin(), ArgsV.end(),
+            [](auto V) { return V->getType()->isPointerTy(); }))
+            CI->setTailCall();
 
-            std::transform(args_.begin(), args_.end(),
-                std::back_inserter(ArgsV), [](auto const& el) {
-                
-                if(!el) throw std::runtime_error{ "" };
+        return CI;
+    }
+    bool Call::emit_loop(BasicBlock* head, ValList const& params) const {
 
-                return el->compile();
-            });
-        }
-        catch(std::exception&) {
+        LineGuard g{};
+        Lexer::line_ = saved_;
 
-            return nullptr;
-        }
+        auto F = head ? head->getParent() : nullptr;
+        if(!F || callee() != F) return false;
+        if(std::find(params.begin(), params.end(), nullptr) != params.end())
+            return false;
+
+        //all arguments are evaluated before any parameter is overwritten
+        ValList ArgsV;
+        if(!emit_args(F, ArgsV)) return true;
+
+        for(size_t i = 0, sz = ArgsV.size(); i < sz; i++)
+            Parser::Builder.CreateStore(ArgsV[i], params[i]);
+        Parser::Builder.CreateBr(head);
 
-        return Parser::Builder.CreateCall(Calee, ArgsV);
+        return true;
     }
 
     FConstant::FConstant(std::unique_ptr<Token> t) noexcept 
         : Expr{ std::move(t) } {}
+    bool FConstant::is_integral() const {
+
+        if(!op_) return false;
+
+        double v = *dynamic_cast<Num const*>(op_.get());
+        double intp;
+
+        //beyond 2^53 doubles stop being exact integers anyway
+        return std::modf(v, &intp) == 0 && std::abs(v) <= 9007199254740992.0;
+    }
     Value* FConstant::compile() {
 
         if(!op_) return nullptr;
 
-        return ConstantFP::get(Parser::Context, 
-            APFloat(static_cast<double>(*dynamic_cast<Num const*>(op_.get()))));
+        double v = *dynamic_cast<Num const*>(op_.get());
+
+        if(is_integral())
+            return Parser::Builder.getInt64(static_cast<int64_t>(v));
+
+        return ConstantFP::get(Parser::Context, APFloat(v));
     }
 
     ArrayConstant::ArrayConstant(ArrList lst) : Expr{ nullptr } {
 
-        SmallVector<Constant*, 16> carr{};
+        SmallVector<Constant*, 16> rows{};
 
-        carr_ = ConstantArray::get(
-            ArrayType::get(Parser::Builder.getDoubleTy(), 0), carr);
-        align_ = Parser::layout.getPrefTypeAlign(carr_->getType());
-        auto array_cast = [](auto const& el) {
+        try {
 
-                    auto cnst = dynamic_cast<ArrayConstant const*>(el.get());
-                    if(!cnst)
-                        throw std::runtime_error{ "invalid constant initializer" };
+            for(auto const& el : lst) {
 
-                    return cnst->carr_;
-                };
-        auto constant_cast = [](auto const& el) {
-                    
-                    if(!el) throw std::runtime_error{ "invalid constant initializer" };
-                    auto el_ = el->compile();
-                    if(!el_) throw std::runtime_error{ "invalid constant initializer" };
+                auto row = dynamic_cast<ArrayConstant const*>(el.get());
+                if(!row)
+                    throw std::runtime_error{ "invalid constant initializer" };
+                if(!rows.empty() && row->carr_->getType() != rows[0]->getType())
+                    throw std::runtime_error{ "array rows must have the same shape" };
 
-                    if(auto c_ = dyn_cast<llvm::Constant>(el_)) return c_;
+                rows.push_back(row->carr_);
+            }
+        }
+        catch(std::exception& e) {
 
-                    throw std::runtime_error{ "constant array has non-constant initializer" };
-                };
-        Type* T;
+            rows.clear();
+            Parser::LogErrorV(e.what());
+        }
 
-        try {
-            
-            if(lst.size()) {
+        auto T = rows.empty() ? Parser::Builder.getDoubleTy() : rows[0]->getType();
+        carr_ = ConstantArray::get(ArrayType::get(T, rows.size()), rows);
+        align_ = Parser::layout.getPrefTypeAlign(carr_->getType());
+    }
+    ArrayConstant::ArrayConstant(std::vector<double> const& vals) : Expr{ nullptr },
+        carr_{ ConstantDataArray::get(Parser::Context, llvm::ArrayRef<double>{ vals }) },
+        align_{ Parser::layout.getPrefTypeAlign(carr_->getType()) } {}
+    void ArrayConstant::cast_to(Type* E) {
 
-                if(auto A = dynamic_cast<ArrayConstant const*>(lst.begin()->get())) {
+        //a row of numbers is converted as raw data, element types that
+        //can't be packed go through a constant per element
+        auto pack = [](ConstantDataArray const* D, auto zero) -> Constant* {
 
-                    std::transform(lst.begin(), lst.end(),
-                        std::back_inserter(carr), array_cast);
+            using T = decltype(zero);
+            std::vector<T> vals(D->getNumElements());
 
-                    T = A->carr_->getType();
-                }
-                else {
+            for(size_t i = 0; i < vals.size(); i++) {
 
-                    std::transform(lst.begin(), lst.end(),
-                        std::back_inserter(carr), constant_cast);
-                    
-                    T = Parser::Builder.getDoubleTy();
+                double v = D->getElementType()->isIntegerTy()
+                    ? static_cast<double>(static_cast<int64_t>(D->getElementAsInteger(i)))
+                    : D->getElementAsDouble(i);
+
+                if constexpr(std::is_integral_v<T>) {
+
+                    //out of range values saturate instead of being poison
+                    using S = std::make_signed_t<T>;
+                    constexpr double lo = std::numeric_limits<S>::min();
+                    constexpr double hi = std::numeric_limits<S>::max();
+                    S k = v != v ? 0 : v <= lo ? std::numeric_limits<S>::min()
+                        : v >= hi ? std::numeric_limits<S>::max() : static_cast<S>(v);
+                    vals[i] = static_cast<T>(k);
                 }
+                else
+                    vals[i] = static_cast<T>(v);
+            }
+
+            return ConstantDataArray::get(D->getContext(), llvm::ArrayRef<T>{ vals });
+        };
+
+        std::function<Type*(Type*)> retype = [&](Type* T) -> Type* {
+
+            if(auto AT = dyn_cast<ArrayType>(T))
+                return ArrayType::get(retype(AT->getElementType()), AT->getNumElements());
+
+            return E;
+        };
+
+        std::function<Constant*(Constant*)> cast = [&](Constant* C) -> Constant* {
+
+            if(isa<ConstantAggregateZero>(C))
+                return Constant::getNullValue(retype(C->getType()));
+
+            if(auto D = dyn_cast<ConstantDataArray>(C)) {
+
+                if(D->getElementType() == E) return D;
+                if(E->isDoubleTy()) return pack(D, double{});
+                if(E->isFloatTy()) return pack(D, float{});
+                if(E->isIntegerTy(64)) return pack(D, uint64_t{});
+                if(E->isIntegerTy(32)) return pack(D, uint32_t{});
+            }
 
-                carr_ = ConstantArray::get(ArrayType::get(T, lst.size()), carr);
-                align_ = Parser::layout.getPrefTypeAlign(carr_->getType());
+            if(auto AT = dyn_cast<ArrayType>(C->getType())) {
+
+                SmallVector<Constant*, 16> elems;
+                for(unsigned i = 0, sz = AT->getNumElements(); i < sz; i++)
+                    elems.push_back(cast(C->getAggregateElement(i)));
+
+                return ConstantArray::get(llvm::cast<ArrayType>(retype(AT)), elems);
             }
+
+            if(E->isIntegerTy()) return ConstantExpr::getFPToSI(C, E);
+
+            return ConstantExpr::getFPCast(C, E);
+        };
+
+        carr_ = cast(carr_);
+        align_ = Parser::layout.getPrefTypeAlign(carr_->getType());
+    }
+    bool ArrayConstant::get_bytes(Constant* C, std::string& bytes) {
+
+        if(auto D = dyn_cast<ConstantDataArray>(C)) {
+
+            bytes += D->getRawDataValues();
+            return true;
         }
-        catch(std::exception& e) {
+        if(isa<ConstantAggregateZero>(C)) {
 
-            Parser::LogErrorV(e.what());
+            bytes.append(Parser::layout.getTypeAllocSize(C->getType()), '\0');
+            return true;
         }
+        if(auto A = dyn_cast<ConstantArray>(C))
+            return std::all_of(A->op_begin(), A->op_end(),
+                [&](Use const& el) { return get_bytes(cast<Constant>(el.get()), bytes); });
+
+        return false;
+    }
+    Constant* ArrayConstant::emit_global() const {
+
+        //large tables are laid down as raw bytes in target order, which
+        //the backend writes out in one piece instead of value by value
+        std::string bytes;
+        Constant* Init = carr_;
+        if(!isa<ConstantAggregateZero>(carr_)
+            && Parser::layout.getTypeAllocSize(get_type()) > raw_size_
+            && Parser::layout.isLittleEndian() == sys::IsLittleEndianHost
+            && get_bytes(carr_, bytes))
+            Init = ConstantDataArray::getString(Parser::Context, bytes, false);
+
+        auto G = new GlobalVariable(*Parser::Module, Init->getType(), true,
+            GlobalValue::PrivateLinkage, Init, "array" + std::to_string(cnt_++));
+        G->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+        G->setAlignment(align_);
+
+        return ConstantExpr::getPointerCast(G, PointerType::getUnqual(get_type()));
     }
     Value* ArrayConstant::compile() {
-        
-        std::string name_ = "array" + std::to_string(cnt_++);
 
-        Parser::Module->getOrInsertGlobal(name_, get_type());
-        auto garr = Parser::Module->getNamedGlobal(name_);
+        //constants are uniqued, so equal literals share one global
+        auto& V = pool_[carr_];
+        if(!V) V = emit_global();
 
-        garr->setLinkage(GlobalValue::LinkageTypes::PrivateLinkage);
-        garr->setConstant(true);
-        garr->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
-        garr->setInitializer(carr_);
-        garr->setAlignment(align_);
+        auto G = cast<GlobalVariable>(V->stripPointerCasts());
+        if(G->getAlign().valueOrOne() < align_) G->setAlignment(align_);
 
-        return garr;
+        return V;
     }
     Type* ArrayConstant::get_type() const {
 
@@ -386,54 +1610,135 @@ namespace llvmc::inter {
 
     Logical::Logical(std::unique_ptr<Token> t) noexcept 
         : Expr{ std::move(t) } {}
+    bool Logical::is_integral() const {
 
+        return true;
+    }
     Bool::Bool(std::unique_ptr<Token> t, std::unique_ptr<Expr> e1, 
         std::unique_ptr<Expr> e2) noexcept : Logical{ std::move(t) },
         lhs_{ std::move(e1) }, rhs_{ std::move(e2) } {}
+    Value* Bool::emit_short_circuit(bool is_and) {
+
+        Value* L = lhs_->compile();
+        if(!L) return nullptr;
+        L = Expr::to_cond(L);
+
+        auto F = Parser::Builder.GetInsertBlock()->getParent();
+        auto LhsBB = Parser::Builder.GetInsertBlock();
+        auto RhsBB = BasicBlock::Create(Parser::Context, "", F);
+        auto EndBB = BasicBlock::Create(Parser::Context);
+
+        //the right operand is evaluated only when it decides the result
+        if(is_and)
+            Parser::Builder.CreateCondBr(L, RhsBB, EndBB);
+        else
+            Parser::Builder.CreateCondBr(L, EndBB, RhsBB);
+
+        Parser::Builder.SetInsertPoint(RhsBB);
+        Value* R = rhs_->compile();
+        if(!R) return nullptr;
+        R = Expr::to_cond(R);
+        RhsBB = Parser::Builder.GetInsertBlock();
+        Parser::Builder.CreateBr(EndBB);
+
+        EndBB->insertInto(F);
+        Parser::Builder.SetInsertPoint(EndBB);
+
+        auto Phi = Parser::Builder.CreatePHI(Parser::Builder.getInt1Ty(), 2);
+        Phi->addIncoming(Parser::Builder.getInt1(!is_and), LhsBB);
+        Phi->addIncoming(R, RhsBB);
+
+        return Phi;
+    }
+    bool Bool::has_array() const {
+
+        return (lhs_ && lhs_->has_array()) || (rhs_ && rhs_->has_array());
+    }
+    Value* Bool::emit(Value* L, Value* R) const {
+
+        auto W = dynamic_cast<Word const*>(op_.get());
+
+        //both sides of a lane are already computed, nothing to short-circuit
+        if(W && *W == Word::And)
+            return Parser::Builder.CreateAnd(Expr::to_cond(L), Expr::to_cond(R));
+        if(W && *W == Word::Or)
+            return Parser::Builder.CreateOr(Expr::to_cond(L), Expr::to_cond(R));
+
+        L = Expr::to_integer(L);
+        R = Expr::to_integer(R);
+
+        if(L->getType()->isIntegerTy(64) && R->getType()->isIntegerTy(64)) {
+
+            if(W && *W == Word::le) 
+                return Parser::Builder.CreateICmpSLE(L, R);
+            else if(W && *W == Word::ge) 
+                return Parser::Builder.CreateICmpSGE(L, R);
+            else if(W && *W == Word::eq) 
+                return Parser::Builder.CreateICmpEQ(L, R);
+            else if(W && *W == Word::ne) 
+                return Parser::Builder.CreateICmpNE(L, R);
+            else if(*op_ == Tag{'<'})
+                return Parser::Builder.CreateICmpSLT(L, R);
+            else if(*op_ == Tag{'>'})
+                return Parser::Builder.CreateICmpSGT(L, R);
+        }
+
+        L = Expr::to_double(L);
+        R = Expr::to_double(R);
+
+        if(W) {
+
+            if(*W == Word::le) 
+                return Parser::Builder.CreateFCmpULE(L, R);
+            else if(*W == Word::ge) 
+                return Parser::Builder.CreateFCmpUGE(L, R);
+            else if(*W == Word::eq) 
+                return Parser::Builder.CreateFCmpUEQ(L, R);
+            else if(*W == Word::ne) 
+                return Parser::Builder.CreateFCmpUNE(L, R);
+        }
+        else {
+
+            switch(*op_) {
+
+                case Tag{'<'}:
+                    return Parser::Builder.CreateFCmpULT(L, R);
+                case Tag{'>'}:
+                    return Parser::Builder.CreateFCmpUGT(L, R);
+            }
+        }
+
+        return Parser::LogErrorV("invalid operand type");
+    }
+    Value* Bool::emit_lane(Value* I) {
+
+        if(!has_array()) return Expr::emit_lane(I);
+        if(!lhs_ || !rhs_) return nullptr;
+
+        Value* L = lhs_->emit_lane(I);
+        Value* R = rhs_->emit_lane(I);
+
+        if(!I || !L || !R) return nullptr;
+
+        return emit(L, R);
+    }
     Value* Bool::compile() {
 
         if(!IArray::is_array(lhs_.get()) && !IArray::is_array(rhs_.get())) {
 
             if(!lhs_ || !rhs_) return nullptr;
 
+            auto W = dynamic_cast<Word const*>(op_.get());
+
+            if(W && *W == Word::And) return emit_short_circuit(true);
+            if(W && *W == Word::Or) return emit_short_circuit(false);
+
             Value* L = lhs_->compile();
             Value* R = rhs_->compile();
 
             if(!L || !R) return nullptr;
 
-            if(auto W = dynamic_cast<Word const*>(op_.get()); W) {
-
-                if(*W == Word::Or) 
-                    L = Parser::Builder.CreateOr(L, R);
-                else if(*W == Word::And) 
-                    L = Parser::Builder.CreateAnd(L, R);
-                else if(*W == Word::le) 
-                    L = Parser::Builder.CreateFCmpULE(L, R);
-                else if(*W == Word::ge) 
-                    L = Parser::Builder.CreateFCmpUGE(L, R);
-                else if(*W == Word::eq) 
-                    L = Parser::Builder.CreateFCmpUEQ(L, R);
-                else if(*W == Word::ne) 
-                    L = Parser::Builder.CreateFCmpUNE(L, R);
-
-                return Parser::Builder.CreateUIToFP(L,
-                    Parser::Builder.getDoubleTy());
-            }
-            else {
-
-                switch(*op_) {
-
-                    case Tag{'<'}:
-                        L = Parser::Builder.CreateFCmpULT(L, R);
-                        break;
-                    case Tag{'>'}:
-                        L = Parser::Builder.CreateFCmpUGT(L, R);
-                        break;
-                }
-
-                return Parser::Builder.CreateUIToFP(L,
-                    Parser::Builder.getDoubleTy());
-            }
+            return emit(L, R);
         }
 
         return Parser::LogErrorV("invalid operand type");
@@ -441,6 +1746,20 @@ namespace llvmc::inter {
 
     Not::Not(std::unique_ptr<Token> t, std::unique_ptr<Expr> e) noexcept 
         : Logical{ std::move(t) }, exp_{ std::move(e) } {}
+    bool Not::has_array() const {
+
+        return exp_ && exp_->has_array();
+    }
+    Value* Not::emit_lane(Value* I) {
+
+        if(!has_array()) return Expr::emit_lane(I);
+
+        Value* E = exp_->emit_lane(I);
+
+        if(!I || !E) return nullptr;
+
+        return Parser::Builder.CreateNot(Expr::to_cond(E));
+    }
     Value* Not::compile() {
 
         if(!IArray::is_array(exp_.get())) {    
@@ -451,13 +1770,7 @@ namespace llvmc::inter {
 
             if(!E) return nullptr;
 
-            E = Parser::Builder.CreateXor(
-                Parser::Builder.CreateFCmpUNE(E,
-                ConstantFP::get(Parser::Context, APFloat(0.0))),
-                Parser::Builder.getTrue());
-
-            return Parser::Builder.CreateUIToFP(E,
-                    Parser::Builder.getDoubleTy());
+            return Parser::Builder.CreateNot(Expr::to_cond(E));
         }
 
         return Parser::LogErrorV("invalid operand type");
@@ -467,6 +1780,10 @@ namespace llvmc::inter {
 
         return BasicBlock::Create(Parser::Context);
     }
+    bool Stmt::is_terminated() const {
+
+        return Parser::Builder.GetInsertBlock()->getTerminator();
+    }
     BasicBlock* Stmt::emit_bb(BasicBlock* BB) const {
         
         Function* par = Parser::Builder.GetInsertBlock()->getParent();
@@ -490,7 +1807,7 @@ namespace llvmc::inter {
     Value* StmtSeq::compile() {
 
         if(stmt1_) stmt1_->compile();
-        if(stmt2_) stmt2_->compile();
+        if(stmt2_ && !is_terminated()) stmt2_->compile();
 
         return nullptr;
     }
@@ -504,12 +1821,26 @@ namespace llvmc::inter {
         return nullptr;
     }
 
-    FunStmt::FunStmt(std::unique_ptr<lexer::Token> t, ArgList lst) 
-        : stmt_{ nullptr } {
+    FunStmt::FunStmt(std::unique_ptr<lexer::Token> t, ArgList lst,
+        IndexList ranks, TypeList elems) : stmt_{ nullptr } {
         
-        //function arguments
-        SmallVector<Type*, 8> doubles(lst.size(),
-            Parser::Builder.getDoubleTy());
+        //function arguments: a double per scalar, a pointer to the
+        //first element plus one i64 per dimension per array
+        ranks.resize(lst.size(), 0);
+        elems.resize(lst.size(), Parser::Builder.getDoubleTy());
+        SmallVector<Type*, 8> doubles;
+        for(size_t i = 0, sz = ranks.size(); i < sz; i++) {
+
+            if(!ranks[i]) {
+
+                doubles.push_back(Parser::Builder.getDoubleTy());
+                continue;
+            }
+
+            doubles.push_back(PointerType::getUnqual(
+                IArray::get_storage(elems[i])));
+            doubles.append(ranks[i], Parser::Builder.getInt64Ty());
+        }
 
         if(!t)
             throw std::runtime_error{ "expected function name" };
@@ -525,14 +1856,40 @@ namespace llvmc::inter {
         Parser::Builder.SetInsertPoint(BB);
         
         //emitting function args as variables
+        auto Arg = Func->arg_begin();
         for(size_t i = 0, sz = lst.size(); i < sz; i++) {
 
+            if(ranks[i]) {
+
+                ValList dims;
+                for(size_t j = 1; j <= ranks[i]; j++) dims.push_back(Arg + j);
+
+                ArrayRef::get_ref(std::move(lst[i]), Arg, std::move(dims), elems[i]);
+                //a self tail call can't rebind an array in place
+                params_.push_back(nullptr);
+                Arg += ranks[i] + 1;
+                continue;
+            }
+
+            auto V = Arg++;
             auto IdPtr = Id::get_id(std::move(lst[i]));
-            if(!IdPtr) continue;
-            Parser::Builder.CreateStore(Func->getArg(i), IdPtr->compile());
+            if(!IdPtr) {
+
+                params_.push_back(nullptr);
+                continue;
+            }
+            IdPtr->set_integral(false);
+            params_.push_back(IdPtr->compile());
+            Parser::Builder.CreateStore(V, params_.back());
         }
 
-        ret_ = Parser::Builder.CreateAlloca(Parser::Builder.getDoubleTy());
+        ret_ = Id::emit_alloca(Parser::Builder.getDoubleTy());
+        exit_ = BasicBlock::Create(Parser::Context, "", Func);
+
+        //self tail calls jump back here with fresh parameter values
+        head_ = BasicBlock::Create(Parser::Context, "", Func);
+        DynArray::enter_scope(Parser::Builder.CreateBr(head_));
+        Parser::Builder.SetInsertPoint(head_);
     }
     void FunStmt::init(std::unique_ptr<Stmt> s) {
 
@@ -540,15 +1897,51 @@ namespace llvmc::inter {
     }
     Value* FunStmt::compile() {
         
+        Id::infer();
+
         if(stmt_) stmt_->compile();
+        DynArray::leave_scope();
 
-        if(ret_) {
+        if(ret_ && exit_) {
+
+            //every return branches to the single exit block
+            if(!is_terminated())
+                Parser::Builder.CreateBr(exit_);
+
+            exit_->moveAfter(&exit_->getParent()->back());
+            Parser::Builder.SetInsertPoint(exit_);
+            DynArray::emit_free();
         
             auto V = Parser::Builder.CreateLoad(ret_);
             Parser::Builder.CreateRet(V);
         }
 
-        return nullptr;
+        auto F = Parser::Builder.GetInsertBlock()->getParent();
+
+        promote();
+        ret_ = nullptr;
+        exit_ = nullptr;
+        head_ = nullptr;
+        params_.clear();
+
+        return F;
+    }
+    void FunStmt::promote() const {
+
+        //scalars are rewritten into SSA values right away, so even -O0
+        //output keeps them in registers; only arrays stay in memory
+        auto F = Parser::Builder.GetInsertBlock()->getParent();
+        std::vector<AllocaInst*> allocas;
+
+        for(auto& I : F->getEntryBlock())
+            if(auto AI = dyn_cast<AllocaInst>(&I))
+                if(!AI->getAllocatedType()->isArrayTy() && isAllocaPromotable(AI))
+                    allocas.push_back(AI);
+
+        if(allocas.empty()) return;
+
+        DominatorTree DT{ *F };
+        PromoteMemToReg(allocas, DT);
     }
 
     IfElseBase::IfElseBase(std::unique_ptr<Expr> e, std::unique_ptr<Stmt> s) 
@@ -561,8 +1954,7 @@ namespace llvmc::inter {
 
         if(!V) return nullptr;
         
-        Value* E = Parser::Builder.CreateFPToUI(
-            V, Parser::Builder.getInt1Ty());
+        Value* E = Expr::to_cond(V);
 
         BBList List{ emit_bb(), create_bb() };
 
@@ -574,7 +1966,10 @@ namespace llvmc::inter {
 
         emit_bb(List[1]);
 
-        auto ret = Parser::Builder.CreateBr(List[1]);
+        //a branch that already returned doesn't fall through to the join
+        BranchInst* ret = nullptr;
+        if(!is_terminated())
+            ret = Parser::Builder.CreateBr(List[1]);
         Parser::Builder.SetInsertPoint(List[1]);
 
         return ret;
@@ -597,14 +1992,15 @@ namespace llvmc::inter {
         stmt_{ std::move(s2) } {}
     void IfElse::emit_else(User* U) const {
 
-        if(!U || !stmt_) return;
+        if(!stmt_) return;
 
         stmt_->compile();
 
         auto BB = emit_bb();
-        U->setOperand(0, BB);
+        if(U) U->setOperand(0, BB);
 
-        Parser::Builder.CreateBr(BB);
+        if(!is_terminated())
+            Parser::Builder.CreateBr(BB);
         Parser::Builder.SetInsertPoint(BB);
     }
 
@@ -626,52 +2022,27 @@ namespace llvmc::inter {
 
         if(!V) return;
         
-        Value* E = Parser::Builder.CreateFPToUI(
-            V, Parser::Builder.getInt1Ty());
+        Value* E = Expr::to_cond(V);
 
         Parser::Builder.CreateCondBr(E, B1, B2);
         
     }
     void LoopBase::emit_body(BasicBlock* BB) const {
 
+        //BB is the loop exit, the target of any break inside the body
+        breaks_.push_back(BB);
         if(stmt_)
             stmt_->compile();
+        breaks_.pop_back();
+        DynArray::leave_scope();
 
         emit_bb(BB);
     }
-    void LoopBase::fix_br(BasicBlock* B1, BasicBlock* B2) const {
-
-        for(auto currBB = B1; currBB != B2; currBB = currBB->getNextNode()) {
-
-            bool found{ false };
-            
-            for(auto IB = currBB->begin(); IB != currBB->end();) {
-                
-                if(found) {
-                    IB = IB->eraseFromParent();
-                    continue;
-                }
-
-                User* Br = dyn_cast<BranchInst>(IB);
-                if(Br && (Br->getNumOperands() == 1)){ 
-
-                    auto BB = cast<BasicBlock>(Br->getOperand(0));
-
-                    if(!BB->getParent()) { 
-
-                        Br->setOperand(0, B2);
-                        found = true;
-                    }
-                }
-                IB++;
-            } 
-        }
-    }
     Value* LoopBase::compile() {
         
         auto BB = emit_bb();
 
-        Parser::Builder.CreateBr(BB);
+        DynArray::enter_scope(Parser::Builder.CreateBr(BB));
         Parser::Builder.SetInsertPoint(BB);
 
         return BB;
@@ -691,8 +2062,8 @@ namespace llvmc::inter {
 
         Parser::Builder.SetInsertPoint(List[1]);
         emit_body(List[2]);
-        fix_br(List[1], List[2]);
-        Parser::Builder.CreateBr(List[0]);
+        if(!is_terminated())
+            Parser::Builder.CreateBr(List[0]);
 
         Parser::Builder.SetInsertPoint(List[2]);
 
@@ -710,8 +2081,8 @@ namespace llvmc::inter {
         BBList List{ cast<BasicBlock>(BB), create_bb() };
 
         emit_body(List[1]);
-        emit_cond(List[0], List[1]);
-        fix_br(List[0], List[1]);
+        if(!is_terminated())
+            emit_cond(List[0], List[1]);
 
         Parser::Builder.SetInsertPoint(List[1]);
 
@@ -742,17 +2113,25 @@ namespace llvmc::inter {
     }
     void For::emit_head(Value* V) const {
 
-        if(!V) return;
+        auto AI = dyn_cast_or_null<AllocaInst>(V);
+        if(!AI) return;
 
-        Value* L = Parser::Builder.CreateLoad(V);
+        Value* L = Parser::Builder.CreateLoad(AI->getAllocatedType(), AI);
         Value* Step;
 
-        if(auto change = std::make_unique<Num>(1.0); to_downto_) 
+        //integral counters step with integer ALU ops
+        if(L->getType()->isIntegerTy()) {
+
+            auto One = ConstantInt::get(L->getType(), 1);
+            Step = to_downto_ ? Parser::Builder.CreateAdd(L, One)
+                : Parser::Builder.CreateSub(L, One);
+        }
+        else if(to_downto_) 
             Step = Parser::Builder.CreateFAdd(L, 
-                FConstant{ std::move(change) }.compile());
+                ConstantFP::get(L->getType(), 1.0));
         else
             Step = Parser::Builder.CreateFSub(L, 
-                FConstant{ std::move(change) }.compile());
+                ConstantFP::get(L->getType(), 1.0));
         
         Parser::Builder.CreateStore(Step, V);
     }
@@ -770,9 +2149,11 @@ namespace llvmc::inter {
         Parser::Builder.SetInsertPoint(List[1]);
         emit_body(List[2]);
         //emitting counter increment/decrement
-        emit_head(V);
-        Parser::Builder.CreateBr(List[0]);
-        fix_br(List[1], List[2]);
+        if(!is_terminated()) {
+
+            emit_head(V);
+            Parser::Builder.CreateBr(List[0]);
+        }
 
         Parser::Builder.SetInsertPoint(List[2]);
 
@@ -782,11 +2163,10 @@ namespace llvmc::inter {
     Break::Break() : stmt_{ enclosing_ } {}
     Value* Break::compile() {
         
-        if(!stmt_) 
+        if(!stmt_ || breaks_.empty()) 
             return Parser::LogErrorV("unenclosed break");
 
-        auto BB = create_bb();
-        Parser::Builder.CreateBr(BB);
+        Parser::Builder.CreateBr(breaks_.back());
 
         return nullptr;
     }
@@ -795,10 +2175,21 @@ namespace llvmc::inter {
         : expr_{ std::move(e) } {}
     Value* Return::compile() {
         
-        if(expr_ && ret_)
+        if(!ret_ || !exit_)
+            return Parser::LogErrorV("return outside of a function");
+
+        //direct self-recursion in tail position becomes a loop
+        auto C = dynamic_cast<Call*>(expr_.get());
+        if(C && C->emit_loop(head_, params_))
+            return nullptr;
+
+        if(C) C->set_tail();
+
+        if(expr_)
             if(auto V = expr_->compile())
-                Parser::Builder.CreateStore(
-                    expr_->compile(), ret_);
+                Parser::Builder.CreateStore(Expr::to_double(V), ret_);
+
+        Parser::Builder.CreateBr(exit_);
 
         return nullptr;
     }
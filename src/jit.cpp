@@ -0,0 +1,346 @@
+#include <llvmc/ijit.h>
+#include <llvmc/iruntime.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+
+    using namespace llvm;
+    using namespace orc;
+
+    int report(Error E) {
+
+        logAllUnhandledErrors(std::move(E), errs(), "error: ");
+        return 1;
+    }
+
+    CodeGenOpt::Level codegen_level(llvmc::opt::Level l) {
+
+        switch(l) {
+
+            case llvmc::opt::Level::O1: return CodeGenOpt::Less;
+            case llvmc::opt::Level::O2: return CodeGenOpt::Default;
+            case llvmc::opt::Level::O3: return CodeGenOpt::Aggressive;
+        }
+
+        return CodeGenOpt::None;
+    }
+
+    //the runtime is linked into llvmc itself, the C library is
+    //resolved against the host process
+    Error add_host_symbols(LLJIT& J) {
+
+        auto& JD = J.getMainJITDylib();
+        MangleAndInterner Mangle{ J.getExecutionSession(), J.getDataLayout() };
+        auto symbol = [](auto* F) {
+
+            return JITEvaluatedSymbol{ pointerToJITTargetAddress(F),
+                JITSymbolFlags::Exported };
+        };
+
+        if(auto E = JD.define(absoluteSymbols({
+            { Mangle("llvmc_print"), symbol(&llvmc_print) },
+            { Mangle("llvmc_flush"), symbol(&llvmc_flush) },
+            { Mangle("llvmc_read_f64"), symbol(&llvmc_read_f64) },
+            { Mangle("llvmc_read_f32"), symbol(&llvmc_read_f32) },
+            { Mangle("llvmc_read_i64"), symbol(&llvmc_read_i64) },
+            { Mangle("llvmc_read_i32"), symbol(&llvmc_read_i32) },
+            { Mangle("llvmc_fail"), symbol(&llvmc_fail) },
+            { Mangle("llvmc_map"), symbol(&llvmc_map) },
+            { Mangle("llvmc_unmap"), symbol(&llvmc_unmap) } })))
+            return E;
+
+        auto G = DynamicLibrarySearchGenerator::GetForCurrentProcess(
+            J.getDataLayout().getGlobalPrefix());
+        if(!G) return G.takeError();
+
+        JD.addGenerator(std::move(*G));
+
+        return Error::success();
+    }
+}
+
+namespace llvmc::jit {
+
+    using namespace llvm;
+    using namespace orc;
+
+    Runner::Runner(opt::Level l) noexcept : level_{ l } {}
+    int Runner::run(std::unique_ptr<Module> M,
+        std::unique_ptr<LLVMContext> C) const {
+
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+
+        auto JTMB = JITTargetMachineBuilder::detectHost();
+        if(!JTMB) return report(JTMB.takeError());
+        JTMB->setCodeGenOptLevel(codegen_level(level_));
+
+        auto J = LLJITBuilder().setJITTargetMachineBuilder(std::move(*JTMB)).create();
+        if(!J) return report(J.takeError());
+
+        if(auto E = add_host_symbols(**J))
+            return report(std::move(E));
+
+        if(auto E = (*J)->addIRModule(
+            ThreadSafeModule{ std::move(M), ThreadSafeContext{ std::move(C) } }))
+            return report(std::move(E));
+
+        auto Main = (*J)->lookup("main");
+        if(!Main) return report(Main.takeError());
+
+        auto main = reinterpret_cast<int(*)()>(Main->getAddress());
+
+        return main();
+    }
+
+    //background recompilation of hot functions at -O3
+    class TieredRunner::Tiers {
+
+        LLJIT& jit_;
+        std::unique_ptr<MemoryBuffer> source_;
+        std::vector<std::string> names_;
+        bool verbose_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<unsigned> queue_;
+        bool stop_{ false };
+        std::thread worker_;
+
+        static inline Tiers* active_ = nullptr;
+
+        void work();
+        Error tier_up(std::string const&);
+
+    public:
+
+        Tiers(LLJIT&, std::unique_ptr<MemoryBuffer>,
+            std::vector<std::string>, bool);
+        ~Tiers();
+
+        static void hot(int32_t);
+    };
+
+    TieredRunner::Tiers::Tiers(LLJIT& J, std::unique_ptr<MemoryBuffer> src,
+        std::vector<std::string> names, bool v) 
+        : jit_{ J }, source_{ std::move(src) }, names_{ std::move(names) },
+        verbose_{ v }, worker_{ [this]{ work(); } } {
+
+        active_ = this;
+    }
+    TieredRunner::Tiers::~Tiers() {
+
+        {
+            std::lock_guard lk{ mutex_ };
+            stop_ = true;
+        }
+        cv_.notify_one();
+        worker_.join();
+
+        active_ = nullptr;
+    }
+    void TieredRunner::Tiers::hot(int32_t idx) {
+
+        if(!active_) return;
+
+        {
+            std::lock_guard lk{ active_->mutex_ };
+            active_->queue_.push_back(static_cast<unsigned>(idx));
+        }
+        active_->cv_.notify_one();
+    }
+    void TieredRunner::Tiers::work() {
+
+        for(;;) {
+
+            std::unique_lock lk{ mutex_ };
+            cv_.wait(lk, [this]{ return stop_ || !queue_.empty(); });
+
+            if(stop_) return;
+
+            auto idx = queue_.front();
+            queue_.pop_front();
+            lk.unlock();
+
+            if(auto E = tier_up(names_[idx]))
+                report(std::move(E));
+        }
+    }
+    Error TieredRunner::Tiers::tier_up(std::string const& name) {
+
+        auto start = std::chrono::steady_clock::now();
+
+        //each recompilation works on its own copy of the uninstrumented module,
+        //so it never contends with the lazy compiler for the main context
+        LLVMContext C;
+        auto M = parseBitcodeFile(source_->getMemBufferRef(), C);
+        if(!M) return M.takeError();
+
+        for(auto& F : **M) {
+
+            if(F.isDeclaration()) continue;
+
+            if(F.getName() == name) {
+
+                F.setName(name + ".tier2");
+                F.setLinkage(GlobalValue::ExternalLinkage);
+            }
+            else F.setLinkage(GlobalValue::InternalLinkage);
+        }
+        for(auto& GV : (*M)->globals())
+            if(!GV.isDeclaration()) GV.setLinkage(GlobalValue::InternalLinkage);
+
+        auto JTMB = JITTargetMachineBuilder::detectHost();
+        if(!JTMB) return JTMB.takeError();
+        JTMB->setCodeGenOptLevel(CodeGenOpt::Aggressive);
+
+        auto TM = JTMB->createTargetMachine();
+        if(!TM) return TM.takeError();
+
+        opt::Pipeline{ opt::Level::O3, false, TM->get() }.run(**M);
+
+        auto Obj = SimpleCompiler{ **TM }(**M);
+        if(!Obj) return Obj.takeError();
+
+        if(auto E = jit_.addObjectFile(std::move(*Obj))) return E;
+
+        auto Sym = jit_.lookup(name + ".tier2");
+        if(!Sym) return Sym.takeError();
+        auto Slot = jit_.lookup(name + ".slot");
+        if(!Slot) return Slot.takeError();
+
+        std::atomic_ref<JITTargetAddress>{ 
+            *jitTargetAddressToPointer<JITTargetAddress*>(Slot->getAddress()) }
+            .store(Sym->getAddress(), std::memory_order_release);
+
+        if(verbose_) {
+
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start;
+
+            errs() << "tier-up " << name << ": "
+                << format("%.3f", elapsed.count()) << " ms\n";
+        }
+
+        return Error::success();
+    }
+
+    TieredRunner::TieredRunner(unsigned t, bool v) noexcept
+        : threshold_{ t }, verbose_{ v } {}
+    std::vector<std::string> TieredRunner::instrument(Module& M) const {
+
+        std::vector<std::string> names;
+        auto& C = M.getContext();
+        IRBuilder<> B{ C };
+
+        auto HotType = FunctionType::get(B.getVoidTy(), { B.getInt32Ty() }, false);
+        auto Hot = Function::Create(
+            HotType, Function::ExternalLinkage, "llvmc.hot", M);
+
+        SmallVector<Function*, 16> funs;
+        for(auto& F : M)
+            if(!F.isDeclaration() && F.getName() != "main" && &F != Hot)
+                funs.push_back(&F);
+
+        for(auto F : funs) {
+
+            auto idx = names.size();
+            names.push_back(F->getName().str());
+
+            //every call loads its target from a slot, so a hot function
+            //can be swapped for its optimized version at any time
+            auto Slot = new GlobalVariable(M, F->getType(), false,
+                GlobalValue::ExternalLinkage, F, F->getName() + ".slot");
+
+            SmallVector<CallInst*, 8> calls;
+            for(auto U : F->users())
+                if(auto CI = dyn_cast<CallInst>(U); CI && CI->getCalledOperand() == F)
+                    calls.push_back(CI);
+
+            for(auto CI : calls) {
+
+                B.SetInsertPoint(CI);
+                auto L = B.CreateAlignedLoad(F->getType(), Slot,
+                    M.getDataLayout().getPointerABIAlignment(0));
+                L->setAtomic(AtomicOrdering::Monotonic);
+                CI->setCalledOperand(L);
+            }
+
+            //entry counter, reports the function once it gets hot
+            auto Count = new GlobalVariable(M, B.getInt64Ty(), false,
+                GlobalValue::ExternalLinkage, B.getInt64(0), F->getName() + ".calls");
+
+            auto& Entry = F->getEntryBlock();
+            auto Head = BasicBlock::Create(C, "", F, &Entry);
+            auto Up = BasicBlock::Create(C, "", F, &Entry);
+
+            B.SetInsertPoint(Head);
+            auto N = B.CreateAdd(B.CreateLoad(B.getInt64Ty(), Count), B.getInt64(1));
+            B.CreateStore(N, Count);
+            B.CreateCondBr(B.CreateICmpEQ(N, B.getInt64(threshold_)), Up, &Entry);
+
+            B.SetInsertPoint(Up);
+            B.CreateCall(Hot, { B.getInt32(idx) });
+            B.CreateBr(&Entry);
+        }
+
+        return names;
+    }
+    int TieredRunner::run(std::unique_ptr<Module> M,
+        std::unique_ptr<LLVMContext> C) const {
+
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+
+        SmallVector<char, 0> bitcode;
+        raw_svector_ostream os{ bitcode };
+        WriteBitcodeToFile(*M, os);
+        auto source = MemoryBuffer::getMemBufferCopy(
+            StringRef{ bitcode.data(), bitcode.size() });
+
+        auto names = instrument(*M);
+
+        auto JTMB = JITTargetMachineBuilder::detectHost();
+        if(!JTMB) return report(JTMB.takeError());
+        JTMB->setCodeGenOptLevel(CodeGenOpt::None);
+
+        auto J = LLLazyJITBuilder().setJITTargetMachineBuilder(std::move(*JTMB)).create();
+        if(!J) return report(J.takeError());
+
+        if(auto E = add_host_symbols(**J))
+            return report(std::move(E));
+
+        SymbolMap hook;
+        hook[(*J)->mangleAndIntern("llvmc.hot")] = JITEvaluatedSymbol{
+            pointerToJITTargetAddress(&Tiers::hot), JITSymbolFlags::Exported };
+        if(auto E = (*J)->getMainJITDylib().define(absoluteSymbols(std::move(hook))))
+            return report(std::move(E));
+
+        if(auto E = (*J)->addLazyIRModule(
+            ThreadSafeModule{ std::move(M), ThreadSafeContext{ std::move(C) } }))
+            return report(std::move(E));
+
+        Tiers tiers{ **J, std::move(source), std::move(names), verbose_ };
+
+        auto Main = (*J)->lookup("main");
+        if(!Main) return report(Main.takeError());
+
+        auto main = reinterpret_cast<int(*)()>(Main->getAddress());
+
+        return main();
+    }
+}
\ No newline at end of file
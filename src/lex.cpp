@@ -157,6 +157,20 @@ namespace llvmc::lexer {
             case '>':
                 if(readch('=')) return std::make_unique<Word>(Word::ge);
                 else return std::make_unique<Token>('>');
+            case '"':
+                {
+                    //a string stays on its line and has no escapes
+                    std::stringstream ss{};
+                    for(readch(); peek_ != '"'; readch()) {
+
+                        if(peek_ == '\n' || peek_ == std::char_traits<char>::eof())
+                            return std::make_unique<Token>('"');
+                        ss << peek_;
+                    }
+                    readch();
+
+                    return std::make_unique<Word>(ss.str(), tag_cast(Tag::STR));
+                }
         }
         if(isdigit_s(peek_)) {
             
@@ -0,0 +1,358 @@
+#include <llvmc/ilinalg.h>
+#include <llvmc/inames.h>
+#include <unordered_map>
+
+namespace llvmc::linalg {
+
+    using namespace llvm;
+
+    Kernel::Kernel(Kind k) noexcept : kind_{ k } {}
+
+    std::optional<Kind> Kernel::get_kind(std::string const& name) {
+
+        static const std::unordered_map<std::string, Kind> kinds{
+            { "matmul", Kind::MatMul }, { "transpose", Kind::Transpose } };
+
+        if(auto it = kinds.find(name); it != kinds.end()) return it->second;
+
+        return std::nullopt;
+    }
+    size_t Kernel::get_arity(Kind k) {
+
+        return k == Kind::MatMul ? 3 : 2;
+    }
+
+    Type* Kernel::acc_type(IRBuilder<>& B, SmallVectorImpl<Type*> const& elems) {
+
+        //f32 operands stay in f32 to get twice the lanes, integers go exact
+        //in i64 and any other mix is computed in double
+        bool integral = true, single = true;
+        for(auto E : elems) {
+
+            integral &= E->isIntegerTy();
+            single &= E->isFloatTy();
+        }
+
+        if(single) return B.getFloatTy();
+
+        return integral ? B.getInt64Ty() : B.getDoubleTy();
+    }
+    Value* Kernel::convert(IRBuilder<>& B, Value* V, Type* T) {
+
+        auto From = V->getType()->getScalarType();
+        auto To = T->getScalarType();
+        if(From == To) return V;
+
+        if(To->isIntegerTy())
+            return From->isIntegerTy() ? B.CreateSExtOrTrunc(V, T) : B.CreateFPToSI(V, T);
+
+        return From->isIntegerTy() ? B.CreateSIToFP(V, T) : B.CreateFPCast(V, T);
+    }
+    void Kernel::emit_check(IRBuilder<>& B, Value* Ok, char const* what) {
+
+        auto& M = *B.GetInsertBlock()->getModule();
+        auto F = B.GetInsertBlock()->getParent();
+        auto Fail = M.getOrInsertFunction("llvmc_fail", FunctionType::get(
+            B.getVoidTy(), { B.getInt8PtrTy() }, false));
+
+        auto FailBB = BasicBlock::Create(M.getContext(), "", F);
+        auto OkBB = BasicBlock::Create(M.getContext(), "", F);
+        B.CreateCondBr(Ok, OkBB, FailBB);
+
+        B.SetInsertPoint(FailBB);
+        B.CreateCall(Fail, { B.CreateGlobalStringPtr(what) })->setDoesNotReturn();
+        B.CreateUnreachable();
+
+        B.SetInsertPoint(OkBB);
+    }
+    Value* Kernel::emit_distinct(IRBuilder<>& B, Value* P, Value* Q) {
+
+        return B.CreateICmpNE(B.CreatePointerCast(P, B.getInt8PtrTy()),
+            B.CreatePointerCast(Q, B.getInt8PtrTy()));
+    }
+    Value* Kernel::emit_min(IRBuilder<>& B, Value* X, Value* Y) {
+
+        return B.CreateSelect(B.CreateICmpSLT(X, Y), X, Y);
+    }
+    Value* Kernel::emit_load(IRBuilder<>& B, Type* E, Value* P, Value* Off, Type* To) {
+
+        auto& DL = B.GetInsertBlock()->getModule()->getDataLayout();
+        Value* Ptr = B.CreateGEP(E, P, Off);
+        Type* T = E;
+        if(auto VT = dyn_cast<FixedVectorType>(To)) {
+
+            T = FixedVectorType::get(E, VT->getNumElements());
+            Ptr = B.CreatePointerCast(Ptr, PointerType::getUnqual(T));
+        }
+
+        return convert(B, B.CreateAlignedLoad(T, Ptr, DL.getABITypeAlign(E)), To);
+    }
+    void Kernel::emit_store(IRBuilder<>& B, Type* E, Value* P, Value* Off, Value* V) {
+
+        auto& DL = B.GetInsertBlock()->getModule()->getDataLayout();
+        Value* Ptr = B.CreateGEP(E, P, Off);
+        Type* T = E;
+        if(auto VT = dyn_cast<FixedVectorType>(V->getType())) {
+
+            T = FixedVectorType::get(E, VT->getNumElements());
+            Ptr = B.CreatePointerCast(Ptr, PointerType::getUnqual(T));
+        }
+
+        B.CreateAlignedStore(convert(B, V, T), Ptr, DL.getABITypeAlign(E));
+    }
+    void Kernel::emit_loop(IRBuilder<>& B, Value* From, Value* To, uint64_t Step,
+        function_ref<void(Value*)> body) {
+
+        auto F = B.GetInsertBlock()->getParent();
+        auto& C = F->getContext();
+        auto PreBB = B.GetInsertBlock();
+        auto HeadBB = BasicBlock::Create(C, "", F);
+        auto BodyBB = BasicBlock::Create(C, "", F);
+        B.CreateBr(HeadBB);
+
+        //To - From is a multiple of Step wherever Step is not 1
+        B.SetInsertPoint(HeadBB);
+        auto I = B.CreatePHI(B.getInt64Ty(), 2);
+        I->addIncoming(From, PreBB);
+        auto DoneBB = BasicBlock::Create(C, "", F);
+        B.CreateCondBr(B.CreateICmpSLT(I, To), BodyBB, DoneBB);
+
+        B.SetInsertPoint(BodyBB);
+        body(I);
+        I->addIncoming(B.CreateAdd(I, B.getInt64(Step)), B.GetInsertBlock());
+        B.CreateBr(HeadBB);
+
+        DoneBB->moveAfter(B.GetInsertBlock());
+        B.SetInsertPoint(DoneBB);
+    }
+
+    void Kernel::emit_panel(IRBuilder<>& B, Function& F,
+        SmallVectorImpl<Type*> const& elems, Type* VT, unsigned R,
+        Value* I, Value* KK, Value* KE, Value* J0, Value* J1) const {
+
+        auto& C = F.getContext();
+        auto PC = F.getArg(0), M = F.getArg(2);
+        auto PA = F.getArg(3), K = F.getArg(5), PB = F.getArg(6);
+        auto Ec = elems[0], Ea = elems[1], Eb = elems[2];
+        auto T = VT->getScalarType();
+        unsigned W = 1, V = 1;
+        if(auto FT = dyn_cast<FixedVectorType>(VT)) {
+
+            W = FT->getNumElements();
+            V = vecs_;
+        }
+
+        emit_loop(B, J0, J1, W * V, [&](Value* J) {
+
+            //an R x V block of C is held in registers over the whole k tile
+            SmallVector<Value*, 8> offs, rows;
+            for(unsigned r = 0; r < R; r++) {
+
+                auto Row = B.CreateAdd(I, B.getInt64(r));
+                rows.push_back(B.CreateMul(Row, K));
+                for(unsigned v = 0; v < V; v++)
+                    offs.push_back(B.CreateAdd(B.CreateMul(Row, M),
+                        B.CreateAdd(J, B.getInt64(v * W))));
+            }
+
+            SmallVector<Value*, 8> init;
+            for(auto Off : offs) init.push_back(emit_load(B, Ec, PC, Off, VT));
+
+            auto PreBB = B.GetInsertBlock();
+            auto HeadBB = BasicBlock::Create(C, "", &F);
+            auto BodyBB = BasicBlock::Create(C, "", &F);
+            auto DoneBB = BasicBlock::Create(C, "", &F);
+            B.CreateBr(HeadBB);
+
+            B.SetInsertPoint(HeadBB);
+            auto KI = B.CreatePHI(B.getInt64Ty(), 2);
+            KI->addIncoming(KK, PreBB);
+            SmallVector<PHINode*, 8> accs;
+            for(auto X : init) {
+
+                accs.push_back(B.CreatePHI(VT, 2));
+                accs.back()->addIncoming(X, PreBB);
+            }
+            B.CreateCondBr(B.CreateICmpSLT(KI, KE), BodyBB, DoneBB);
+
+            //one row of B against a broadcast element of each row of A
+            B.SetInsertPoint(BodyBB);
+            auto BRow = B.CreateMul(KI, M);
+            SmallVector<Value*, 4> bs;
+            for(unsigned v = 0; v < V; v++)
+                bs.push_back(emit_load(B, Eb, PB,
+                    B.CreateAdd(BRow, B.CreateAdd(J, B.getInt64(v * W))), VT));
+            for(unsigned r = 0; r < R; r++) {
+
+                Value* X = emit_load(B, Ea, PA, B.CreateAdd(rows[r], KI), T);
+                if(W > 1) X = B.CreateVectorSplat(W, X);
+
+                for(unsigned v = 0; v < V; v++) {
+
+                    auto Acc = accs[r * V + v];
+                    Value* S = T->isIntegerTy()
+                        ? B.CreateAdd(Acc, B.CreateMul(X, bs[v]))
+                        : B.CreateIntrinsic(Intrinsic::fmuladd, { VT }, { X, bs[v], Acc });
+                    Acc->addIncoming(S, BodyBB);
+                }
+            }
+            KI->addIncoming(B.CreateAdd(KI, B.getInt64(1)), BodyBB);
+            B.CreateBr(HeadBB);
+
+            B.SetInsertPoint(DoneBB);
+            for(size_t a = 0, sz = accs.size(); a < sz; a++)
+                emit_store(B, Ec, PC, offs[a], accs[a]);
+        });
+    }
+    void Kernel::emit_matmul(Function& F, SmallVectorImpl<Type*> const& elems) const {
+
+        auto& C = F.getContext();
+        auto& DL = F.getParent()->getDataLayout();
+        IRBuilder<> B{ BasicBlock::Create(C, "", &F) };
+
+        auto T = acc_type(B, elems);
+        auto VT = FixedVectorType::get(T, vector_bits_ / T->getPrimitiveSizeInBits());
+        uint64_t step = VT->getNumElements() * vecs_;
+        auto PC = F.getArg(0), N = F.getArg(1), M = F.getArg(2), K = F.getArg(5);
+
+        //C is cleared before A and B are read and is marked noalias, so
+        //a parameter bound to the same array as an operand is an error
+        emit_check(B, B.CreateAnd(emit_distinct(B, PC, F.getArg(3)),
+            emit_distinct(B, PC, F.getArg(6))),
+            "matmul target array is also an operand");
+
+        emit_check(B, B.CreateAnd(B.CreateAnd(B.CreateICmpEQ(N, F.getArg(4)),
+            B.CreateICmpEQ(K, F.getArg(7))), B.CreateICmpEQ(M, F.getArg(8))),
+            "matmul array shapes do not match");
+
+        auto Ec = elems[0];
+        B.CreateMemSet(PC, B.getInt8(0), B.CreateMul(B.CreateMul(N, M),
+            B.getInt64(DL.getTypeAllocSize(Ec))), DL.getABITypeAlign(Ec));
+        auto Rows = B.CreateAnd(N, B.getInt64(~uint64_t(rows_ - 1)));
+
+        //a k x j tile of B stays in cache while every row of A passes over it
+        emit_loop(B, B.getInt64(0), M, tile_j_, [&](Value* JJ) {
+
+            auto JE = emit_min(B, B.CreateAdd(JJ, B.getInt64(tile_j_)), M);
+            auto JV = B.CreateAdd(JJ, B.CreateAnd(B.CreateSub(JE, JJ),
+                B.getInt64(~(step - 1))));
+
+            emit_loop(B, B.getInt64(0), K, tile_k_, [&](Value* KK) {
+
+                auto KE = emit_min(B, B.CreateAdd(KK, B.getInt64(tile_k_)), K);
+                auto block = [&](unsigned R, Value* I) {
+
+                    emit_panel(B, F, elems, VT, R, I, KK, KE, JJ, JV);
+                    emit_panel(B, F, elems, T, R, I, KK, KE, JV, JE);
+                };
+
+                emit_loop(B, B.getInt64(0), Rows, rows_,
+                    [&](Value* I) { block(rows_, I); });
+                emit_loop(B, Rows, N, 1, [&](Value* I) { block(1, I); });
+            });
+        });
+        B.CreateRet(ConstantFP::get(B.getDoubleTy(), 0.0));
+    }
+    void Kernel::emit_transpose(Function& F, SmallVectorImpl<Type*> const& elems) const {
+
+        auto& C = F.getContext();
+        IRBuilder<> B{ BasicBlock::Create(C, "", &F) };
+
+        auto Eb = elems[0], Ea = elems[1];
+        auto PB = F.getArg(0), PA = F.getArg(3), N = F.getArg(4), M = F.getArg(5);
+        auto VT = FixedVectorType::get(Eb, block_);
+
+        emit_check(B, emit_distinct(B, PB, PA),
+            "transpose target array is also its operand");
+
+        emit_check(B, B.CreateAnd(B.CreateICmpEQ(F.getArg(1), M),
+            B.CreateICmpEQ(F.getArg(2), N)), "transpose array shapes do not match");
+
+        auto Mask = B.getInt64(~uint64_t(block_ - 1));
+        auto N4 = B.CreateAnd(N, Mask), M4 = B.CreateAnd(M, Mask);
+        auto copy = [&](Value* I, Value* J) {
+
+            auto X = emit_load(B, Ea, PA, B.CreateAdd(B.CreateMul(I, M), J), Eb);
+            emit_store(B, Eb, PB, B.CreateAdd(B.CreateMul(J, N), I), X);
+        };
+
+        //tiles keep both the rows read and the rows written in cache,
+        //inside them 4 x 4 blocks are transposed in registers
+        emit_loop(B, B.getInt64(0), N4, tile_t_, [&](Value* II) {
+
+            auto IE = emit_min(B, B.CreateAdd(II, B.getInt64(tile_t_)), N4);
+            emit_loop(B, B.getInt64(0), M4, tile_t_, [&](Value* JJ) {
+
+                auto JE = emit_min(B, B.CreateAdd(JJ, B.getInt64(tile_t_)), M4);
+                emit_loop(B, II, IE, block_, [&](Value* I) {
+
+                    emit_loop(B, JJ, JE, block_, [&](Value* J) {
+
+                        static const int Even[]{ 0, 4, 1, 5 }, Odd[]{ 2, 6, 3, 7 };
+                        static const int Low[]{ 0, 1, 4, 5 }, High[]{ 2, 3, 6, 7 };
+
+                        Value* R[block_];
+                        for(unsigned r = 0; r < block_; r++)
+                            R[r] = emit_load(B, Ea, PA, B.CreateAdd(B.CreateMul(
+                                B.CreateAdd(I, B.getInt64(r)), M), J), VT);
+
+                        auto Lo0 = B.CreateShuffleVector(R[0], R[1], Even);
+                        auto Hi0 = B.CreateShuffleVector(R[0], R[1], Odd);
+                        auto Lo1 = B.CreateShuffleVector(R[2], R[3], Even);
+                        auto Hi1 = B.CreateShuffleVector(R[2], R[3], Odd);
+                        Value* Cols[block_]{
+                            B.CreateShuffleVector(Lo0, Lo1, Low),
+                            B.CreateShuffleVector(Lo0, Lo1, High),
+                            B.CreateShuffleVector(Hi0, Hi1, Low),
+                            B.CreateShuffleVector(Hi0, Hi1, High) };
+
+                        for(unsigned c = 0; c < block_; c++)
+                            emit_store(B, Eb, PB, B.CreateAdd(B.CreateMul(
+                                B.CreateAdd(J, B.getInt64(c)), N), I), Cols[c]);
+                    });
+                });
+            });
+        });
+
+        //the edges left over by the blocks, one element at a time
+        emit_loop(B, B.getInt64(0), N4, 1, [&](Value* I) {
+
+            emit_loop(B, M4, M, 1, [&](Value* J) { copy(I, J); });
+        });
+        emit_loop(B, N4, N, 1, [&](Value* I) {
+
+            emit_loop(B, B.getInt64(0), M, 1, [&](Value* J) { copy(I, J); });
+        });
+        B.CreateRet(ConstantFP::get(B.getDoubleTy(), 0.0));
+    }
+
+    Function* Kernel::get(Module& M, SmallVectorImpl<Type*> const& elems) const {
+
+        std::string name = kind_ == Kind::MatMul ? "llvmc.matmul" : "llvmc.transpose";
+        for(auto E : elems) {
+
+            name += '.';
+            names::append_type(name, E);
+        }
+
+        //calls with the same operand types share a kernel
+        if(auto F = M.getFunction(name)) return F;
+
+        //every array comes as its data followed by its two extents
+        auto I64 = Type::getInt64Ty(M.getContext());
+        SmallVector<Type*, 9> params;
+        for(auto E : elems) params.append({ PointerType::getUnqual(E), I64, I64 });
+
+        auto F = Function::Create(FunctionType::get(
+            Type::getDoubleTy(M.getContext()), params, false),
+            Function::ExternalLinkage, name, &M);
+        //the target is never one of the operands
+        F->addParamAttr(0, Attribute::NoAlias);
+        F->addFnAttr(Attribute::NoUnwind);
+
+        if(kind_ == Kind::MatMul) emit_matmul(*F, elems);
+        else emit_transpose(*F, elems);
+
+        return F;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include <llvmc/imemo.h>
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Operator.h"
+
+namespace llvmc::memo {
+
+    using namespace llvm;
+
+    Memoizer::Memoizer(bool f) noexcept : forced_{ f } {}
+
+    bool Memoizer::is_pure(Function const& F) {
+
+        if(F.isDeclaration()) return false;
+
+        for(auto& A : F.args())
+            if(!A.getType()->isDoubleTy()) return false;
+
+        for(auto& I : instructions(F)) {
+
+            if(auto CB = dyn_cast<CallBase>(&I)) {
+
+                auto Callee = CB->getCalledFunction();
+                if(!Callee || (Callee != &F && !pure_.count(Callee)))
+                    return false;
+
+                continue;
+            }
+
+            Value const* Ptr = nullptr;
+            if(auto LI = dyn_cast<LoadInst>(&I)) Ptr = LI->getPointerOperand();
+            else if(auto SI = dyn_cast<StoreInst>(&I)) Ptr = SI->getPointerOperand();
+            else if(I.mayReadOrWriteMemory()) return false;
+
+            if(!Ptr) continue;
+
+            //only the function's own frame and constant tables may be touched
+            while(auto GEP = dyn_cast<GEPOperator>(Ptr))
+                Ptr = GEP->getPointerOperand();
+            auto G = dyn_cast<GlobalVariable>(Ptr->stripPointerCasts());
+            if(!isa<AllocaInst>(Ptr) && !(G && G->isConstant() && isa<LoadInst>(I)))
+                return false;
+        }
+
+        return true;
+    }
+
+    unsigned Memoizer::self_calls(Function const& F) {
+
+        unsigned n = 0;
+
+        for(auto& I : instructions(F))
+            if(auto CB = dyn_cast<CallBase>(&I))
+                n += CB->getCalledFunction() == &F;
+
+        return n;
+    }
+
+    GlobalVariable* Memoizer::emit_table(Module& M, Type* T,
+        uint64_t n, std::string const& name) {
+
+        auto AT = ArrayType::get(T, n);
+
+        return new GlobalVariable(M, AT, false, GlobalValue::InternalLinkage,
+            ConstantAggregateZero::get(AT), name);
+    }
+
+    Value* Memoizer::emit_call(IRBuilder<>& B, Function& W, Function& F) {
+
+        SmallVector<Value*, 8> args;
+        for(auto& A : W.args()) args.push_back(&A);
+
+        return B.CreateCall(&F, args);
+    }
+
+    void Memoizer::emit_dense(IRBuilder<>& B, Function& W,
+        Function& F, BasicBlock* miss) {
+
+        auto& C = W.getContext();
+        auto name = W.getName().str();
+        auto X = W.getArg(0);
+
+        auto vals = emit_table(*W.getParent(), B.getDoubleTy(),
+            dense_size_, name + ".memo.dense");
+        auto set = emit_table(*W.getParent(), B.getInt8Ty(),
+            dense_size_, name + ".memo.dset");
+
+        auto ConvBB = BasicBlock::Create(C, "", &W);
+        auto LookBB = BasicBlock::Create(C, "", &W);
+        auto HitBB = BasicBlock::Create(C, "", &W);
+        auto FillBB = BasicBlock::Create(C, "", &W);
+
+        //small non-negative integers index the table directly
+        auto InRange = B.CreateAnd(
+            B.CreateFCmpOGE(X, ConstantFP::get(B.getDoubleTy(), 0.0)),
+            B.CreateFCmpOLT(X, ConstantFP::get(B.getDoubleTy(),
+                static_cast<double>(dense_size_))));
+        B.CreateCondBr(InRange, ConvBB, miss);
+
+        B.SetInsertPoint(ConvBB);
+        auto I = B.CreateFPToSI(X, B.getInt64Ty());
+        auto Exact = B.CreateICmpEQ(
+            B.CreateBitCast(B.CreateSIToFP(I, B.getDoubleTy()), B.getInt64Ty()),
+            B.CreateBitCast(X, B.getInt64Ty()));
+        B.CreateCondBr(Exact, LookBB, miss);
+
+        B.SetInsertPoint(LookBB);
+        Value* Idx[]{ B.getInt64(0), I };
+        auto VP = B.CreateGEP(vals->getValueType(), vals, Idx);
+        auto SP = B.CreateGEP(set->getValueType(), set, Idx);
+        auto S = B.CreateLoad(B.getInt8Ty(), SP);
+        B.CreateCondBr(B.CreateICmpNE(S, B.getInt8(0)), HitBB, FillBB);
+
+        B.SetInsertPoint(HitBB);
+        B.CreateRet(B.CreateLoad(B.getDoubleTy(), VP));
+
+        B.SetInsertPoint(FillBB);
+        auto V = emit_call(B, W, F);
+        B.CreateStore(V, VP);
+        B.CreateStore(B.getInt8(1), SP);
+        B.CreateRet(V);
+    }
+
+    void Memoizer::emit_hash(IRBuilder<>& B, Function& W, Function& F) {
+
+        auto& C = W.getContext();
+        auto name = W.getName().str();
+        uint64_t k = W.arg_size();
+        uint64_t mask = hash_size_ - 1;
+
+        auto keys = emit_table(*W.getParent(), B.getInt64Ty(),
+            hash_size_ * std::max<uint64_t>(k, 1), name + ".memo.keys");
+        auto vals = emit_table(*W.getParent(), B.getDoubleTy(),
+            hash_size_, name + ".memo.vals");
+        auto used = emit_table(*W.getParent(), B.getInt8Ty(),
+            hash_size_, name + ".memo.used");
+
+        //keys are compared bitwise, so -0.0 and NaNs never alias
+        SmallVector<Value*, 8> bits;
+        Value* H = B.getInt64(0);
+        for(auto& A : W.args()) {
+
+            bits.push_back(B.CreateBitCast(&A, B.getInt64Ty()));
+            H = B.CreateMul(B.CreateXor(H, bits.back()),
+                B.getInt64(0x9E3779B97F4A7C15ull));
+        }
+        //doubles keep their entropy in the high bits, so the slot is
+        //taken from the top of the product (Fibonacci hashing)
+        auto Start = B.CreateLShr(H, 64 - hash_bits_);
+
+        auto HeadBB = B.GetInsertBlock();
+        auto ProbeBB = BasicBlock::Create(C, "", &W);
+        auto CmpBB = BasicBlock::Create(C, "", &W);
+        auto HitBB = BasicBlock::Create(C, "", &W);
+        auto NextBB = BasicBlock::Create(C, "", &W);
+        auto FillBB = BasicBlock::Create(C, "", &W);
+        auto SlowBB = BasicBlock::Create(C, "", &W);
+        B.CreateBr(ProbeBB);
+
+        //linear probing over a bounded window of slots
+        B.SetInsertPoint(ProbeBB);
+        auto N = B.CreatePHI(B.getInt64Ty(), 2);
+        N->addIncoming(B.getInt64(0), HeadBB);
+        auto Slot = B.CreateAnd(B.CreateAdd(Start, N), mask);
+        auto Base = B.CreateMul(Slot, B.getInt64(std::max<uint64_t>(k, 1)));
+        Value* UIdx[]{ B.getInt64(0), Slot };
+        auto UP = B.CreateGEP(used->getValueType(), used, UIdx);
+        auto U = B.CreateLoad(B.getInt8Ty(), UP);
+        B.CreateCondBr(B.CreateICmpEQ(U, B.getInt8(0)), FillBB, CmpBB);
+
+        B.SetInsertPoint(CmpBB);
+        Value* Eq = B.getTrue();
+        for(uint64_t j = 0; j < k; j++) {
+
+            Value* KIdx[]{ B.getInt64(0), B.CreateAdd(Base, B.getInt64(j)) };
+            auto KP = B.CreateGEP(keys->getValueType(), keys, KIdx);
+            Eq = B.CreateAnd(Eq, B.CreateICmpEQ(
+                B.CreateLoad(B.getInt64Ty(), KP), bits[j]));
+        }
+        B.CreateCondBr(Eq, HitBB, NextBB);
+
+        B.SetInsertPoint(HitBB);
+        B.CreateRet(B.CreateLoad(B.getDoubleTy(),
+            B.CreateGEP(vals->getValueType(), vals, UIdx)));
+
+        B.SetInsertPoint(NextBB);
+        auto N1 = B.CreateAdd(N, B.getInt64(1));
+        N->addIncoming(N1, NextBB);
+        B.CreateCondBr(B.CreateICmpULT(N1, B.getInt64(max_probe_)),
+            ProbeBB, SlowBB);
+
+        //the slot is filled only after the call, which may itself
+        //have claimed it; the newer entry simply wins
+        B.SetInsertPoint(FillBB);
+        auto V = emit_call(B, W, F);
+        for(uint64_t j = 0; j < k; j++) {
+
+            Value* KIdx[]{ B.getInt64(0), B.CreateAdd(Base, B.getInt64(j)) };
+            B.CreateStore(bits[j], B.CreateGEP(keys->getValueType(), keys, KIdx));
+        }
+        B.CreateStore(V, B.CreateGEP(vals->getValueType(), vals, UIdx));
+        B.CreateStore(B.getInt8(1), UP);
+        B.CreateRet(V);
+
+        //the window is full: compute without caching
+        B.SetInsertPoint(SlowBB);
+        B.CreateRet(emit_call(B, W, F));
+    }
+
+    void Memoizer::wrap(Function& F) {
+
+        auto& C = F.getContext();
+
+        //every caller, including F itself, goes through the table
+        auto W = Function::Create(F.getFunctionType(),
+            F.getLinkage(), "", F.getParent());
+        F.replaceAllUsesWith(W);
+        W->takeName(&F);
+        F.setName(W->getName() + ".impl");
+        F.setLinkage(GlobalValue::InternalLinkage);
+        pure_.insert(W);
+
+        IRBuilder<> B{ BasicBlock::Create(C, "", W) };
+        auto HashBB = BasicBlock::Create(C, "", W);
+
+        if(W->arg_size() == 1)
+            emit_dense(B, *W, F, HashBB);
+        else
+            B.CreateBr(HashBB);
+
+        B.SetInsertPoint(HashBB);
+        emit_hash(B, *W, F);
+    }
+
+    bool Memoizer::run(Function& F) const {
+
+        bool pure = is_pure(F);
+        if(pure) pure_.insert(&F);
+
+        if(forced_ && !pure) return false;
+
+        //tree recursion is where the table turns exponential into linear
+        if(pure && (forced_ || self_calls(F) > 1))
+            wrap(F);
+
+        return true;
+    }
+}
\ No newline at end of file
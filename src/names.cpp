@@ -0,0 +1,17 @@
+#include <llvmc/inames.h>
+
+namespace llvmc::names {
+
+    using namespace llvm;
+
+    void append_type(std::string& name, Type* T) {
+
+        if(T->isFloatTy()) name += "f32";
+        else if(T->isDoubleTy()) name += "f64";
+        else {
+
+            name += 'i';
+            name += std::to_string(T->getIntegerBitWidth());
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include <llvmc/iopt.h>
+#include <chrono>
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace llvmc::opt {
+
+    using namespace llvm;
+
+#if LLVM_VERSION_MAJOR < 13
+    using OptimizationLevel = PassBuilder::OptimizationLevel;
+#endif
+
+    Pipeline::Pipeline(Level l, bool t, TargetMachine* TM) noexcept
+        : level_{ l }, time_{ t }, machine_{ TM } {}
+    bool Pipeline::run(Module& M) const {
+
+        if(verifyModule(M, &errs())) {
+
+            errs() << "error: generated module is broken\n";
+            return false;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        if(level_ != Level::O0) {
+
+            LoopAnalysisManager LAM;
+            FunctionAnalysisManager FAM;
+            CGSCCAnalysisManager CGAM;
+            ModuleAnalysisManager MAM;
+            PassBuilder PB{ machine_ };
+
+            PB.registerModuleAnalyses(MAM);
+            PB.registerCGSCCAnalyses(CGAM);
+            PB.registerFunctionAnalyses(FAM);
+            PB.registerLoopAnalyses(LAM);
+            PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+            OptimizationLevel OL = OptimizationLevel::O1;
+            if(level_ == Level::O2) OL = OptimizationLevel::O2;
+            else if(level_ == Level::O3) OL = OptimizationLevel::O3;
+
+            auto MPM = PB.buildPerModuleDefaultPipeline(OL);
+            MPM.run(M, MAM);
+        }
+
+        if(time_) {
+
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start;
+
+            errs() << "-O" << static_cast<unsigned>(level_)
+                << " pipeline: " << format("%.3f", elapsed.count()) << " ms\n";
+        }
+
+        return true;
+    }
+}
\ No newline at end of file
@@ -1,8 +1,9 @@
 #include <llvmc/iparser.h>
+#include <llvmc/ijit.h>
+#include <llvmc/imemo.h>
+#include <llvmc/iattrs.h>
 #include <regex>
-#include <fstream>
 #include "llvm/Support/raw_ostream.h"
-#include "llvm/Support/raw_os_ostream.h"
 
 namespace llvmc::parser {
 
@@ -27,14 +28,16 @@ namespace llvmc::parser {
         }
     };
 
-    Parser::Parser(Lexer lex, std::string p) 
-        : lex_{ std::move(lex) }, path_{ std::move(p) } {
+    Parser::Parser(Lexer lex, std::string p, Options o) 
+        : lex_{ std::move(lex) }, path_{ std::move(p) }, opts_{ o } {
 
         move();
     }
 
     std::string Parser::get_output_name() const {
 
+        if(!opts_.output_.empty()) return opts_.output_;
+
         std::regex FilenamePattern("[^/]+$");
         std::smatch RegexMatch;
         std::regex_search(path_, RegexMatch, FilenamePattern);
@@ -43,7 +46,7 @@ namespace llvmc::parser {
         std::regex ExtensionPattern("\\.txt?$");
         std::string Name = std::regex_replace(FileName, ExtensionPattern, "");
 
-        return Name + ".ll";
+        return Name + emit::Emitter::get_extension(opts_.emit_);
     }
 
     std::nullptr_t Parser::LogErrorV(std::string s) {
@@ -69,9 +72,22 @@ namespace llvmc::parser {
 
     void Parser::move() {
 
+        if(!back_.empty()) {
+
+            tok_ = std::move(back_.back());
+            back_.pop_back();
+            return;
+        }
+
         tok_ = lex_.scan();
     }
 
+    void Parser::unget(std::unique_ptr<Token> t) {
+
+        back_.push_back(std::move(tok_));
+        tok_ = std::move(t);
+    }
+
     std::unique_ptr<Token> Parser::match(Tag t) {
         
         check_end();
@@ -93,46 +109,29 @@ namespace llvmc::parser {
 
     void Parser::program_preinit() {
 
-        std::vector<Type*> args_type{ Builder.getInt8PtrTy() };
-
-        auto funType = FunctionType::get(
-            Builder.getInt32Ty(), args_type, true);
-        auto printf = Function::Create(
-            funType, Function::ExternalLinkage, "printf", Module.get());
-        auto scanf = Function::Create(
-            funType, Function::ExternalLinkage, "scanf", Module.get());
+        Machine = emit::Emitter::create_machine(opts_.level_);
+        if(Machine) {
 
-        args_type[0] = Builder.getDoubleTy();
-        auto printFunType = FunctionType::get(
-            Builder.getDoubleTy(), args_type, false);
-        auto print = Function::Create(
-            printFunType, Function::ExternalLinkage, "print", Module.get());
-
-        auto printBB = BasicBlock::Create(Context, "", print);
-        Builder.SetInsertPoint(printBB);
-
-        auto printStr = Builder.CreateGlobalStringPtr("%lf\n");
-        std::vector<Value*> printf_args{ printStr, print->getArg(0)};
-
-        auto pCall = Builder.CreateCall(funType, printf, printf_args);
-        auto pRet = Builder.CreateSIToFP(pCall, Builder.getDoubleTy());
-        Builder.CreateRet(pRet);
+            Module->setTargetTriple(Machine->getTargetTriple().str());
+            Module->setDataLayout(Machine->createDataLayout());
+            layout = Module->getDataLayout();
+        }
 
-        args_type[0] = PointerType::getUnqual(Builder.getDoubleTy());
-        auto readFunType = FunctionType::get(
-            Builder.getDoubleTy(), args_type, false);
-        auto read = Function::Create(
-            readFunType, Function::ExternalLinkage, "read", Module.get());
+        //print forwards to the precompiled runtime, which buffers the
+        //output and flushes it once main is done; read and readn are
+        //builtins bound to its readers per element type
+        auto Dbl = Builder.getDoubleTy();
+        auto rtPrint = Function::Create(FunctionType::get(Dbl, { Dbl }, false),
+            Function::ExternalLinkage, "llvmc_print", Module.get());
+        Function::Create(FunctionType::get(Builder.getVoidTy(), false),
+            Function::ExternalLinkage, "llvmc_flush", Module.get());
 
-        auto readBB = BasicBlock::Create(Context, "", read);
-        Builder.SetInsertPoint(readBB);
-        
-        auto readStr = Builder.CreateGlobalStringPtr("%lf\n");
-        std::vector<Value*> scanf_args{ readStr, read->getArg(0)};
+        auto print = Function::Create(rtPrint->getFunctionType(),
+            Function::ExternalLinkage, "print", Module.get());
+        Builder.SetInsertPoint(BasicBlock::Create(Context, "", print));
+        Builder.CreateRet(Builder.CreateCall(rtPrint, { print->getArg(0) }));
 
-        auto rCall = Builder.CreateCall(funType, scanf, scanf_args);
-        auto rRet = Builder.CreateSIToFP(rCall, Builder.getDoubleTy());
-        Builder.CreateRet(rRet);
+        program_runtime();
 
         auto mainType = FunctionType::get(Builder.getInt32Ty(), false);
         auto main = Function::Create(
@@ -141,12 +140,68 @@ namespace llvmc::parser {
         
         Builder.SetInsertPoint(mainBB);
     }
+    void Parser::program_runtime() {
+
+        auto I8Ptr = Builder.getInt8PtrTy();
+        auto I64 = Builder.getInt64Ty();
+        auto I32 = Builder.getInt32Ty();
+
+        Function::Create(FunctionType::get(Builder.getVoidTy(), { I8Ptr }, false),
+            Function::ExternalLinkage, "free", Module.get());
+        auto abort = Function::Create(FunctionType::get(Builder.getVoidTy(), false),
+            Function::ExternalLinkage, "abort", Module.get());
+        auto memalign = Function::Create(FunctionType::get(
+            I32, { PointerType::getUnqual(I8Ptr), I64, I64 }, false),
+            Function::ExternalLinkage, "posix_memalign", Module.get());
+
+        //llvmc.alloc(bytes) hands out cache-line aligned blocks, and
+        //huge-page aligned ones for anything of at least one huge page
+        auto alloc = Function::Create(FunctionType::get(I8Ptr, { I64 }, false),
+            Function::ExternalLinkage, "llvmc.alloc", Module.get());
+        auto Bytes = alloc->getArg(0);
+
+        auto allocBB = BasicBlock::Create(Context, "", alloc);
+        auto failBB = BasicBlock::Create(Context, "", alloc);
+        auto okBB = BasicBlock::Create(Context, "", alloc);
+        Builder.SetInsertPoint(allocBB);
+
+        auto Huge = Builder.CreateICmpUGE(Bytes, Builder.getInt64(kHugePage));
+        auto Align = Builder.CreateSelect(Huge, 
+            Builder.getInt64(kHugePage), Builder.getInt64(IArray::kCacheLine));
+        auto Ptr = Builder.CreateAlloca(I8Ptr);
+        auto Res = Builder.CreateCall(memalign, { Ptr, Align, Bytes });
+        Builder.CreateCondBr(Builder.CreateICmpNE(Res, Builder.getInt32(0)),
+            failBB, okBB);
+
+        Builder.SetInsertPoint(failBB);
+        Builder.CreateCall(abort);
+        Builder.CreateUnreachable();
+
+        Builder.SetInsertPoint(okBB);
+        auto Mem = Builder.CreateLoad(I8Ptr, Ptr);
+#ifdef __linux__
+        auto adviseBB = BasicBlock::Create(Context, "", alloc);
+        auto retBB = BasicBlock::Create(Context, "", alloc);
+        auto madvise = Function::Create(FunctionType::get(
+            I32, { I8Ptr, I64, I32 }, false),
+            Function::ExternalLinkage, "madvise", Module.get());
+        Builder.CreateCondBr(Huge, adviseBB, retBB);
+
+        Builder.SetInsertPoint(adviseBB);
+        Builder.CreateCall(madvise, { Mem, Bytes, Builder.getInt32(kAdviseHuge) });
+        Builder.CreateBr(retBB);
+
+        Builder.SetInsertPoint(retBB);
+#endif
+        Builder.CreateRet(Mem);
+    }
     void Parser::program_postinit() {
 
+        Builder.CreateCall(Module->getFunction("llvmc_flush"));
         Builder.CreateRet(Builder.getInt32(0)); 
     }
 
-    void Parser::program() {
+    int Parser::program() {
         
         program_preinit();
 
@@ -166,14 +221,29 @@ namespace llvmc::parser {
             std::string err = err_num_ > 1 ? "errors" : "error";
 
             errs() << std::to_string(err_num_) + ' ' + err + " generated\n";
-            return;
+            return 1;
         }
 
+        //the lazy JIT starts every function at -O0 and re-optimizes hot ones itself
+        bool tiered = opts_.run_ && opts_.lazy_;
+        auto level = tiered ? opt::Level::O0 : opts_.level_;
+
+        //the tiered runner swaps functions in by name, so they stay visible
+        attrs::Inferer{ !tiered }.run(*Module);
+
+        if(!opt::Pipeline{ level, opts_.time_, Machine.get() }.run(*Module))
+            return 1;
 
-        std::ofstream out{ get_output_name() };
-        raw_os_ostream OutputFile{ out };
+        if(tiered)
+            return jit::TieredRunner{ opts_.threshold_, opts_.time_ }.run(
+                std::move(Module), std::move(context_));
 
-        Module->print(OutputFile, nullptr);
+        if(opts_.run_)
+            return jit::Runner{ opts_.level_ }.run(
+                std::move(Module), std::move(context_));
+
+        return emit::Emitter{ opts_.emit_, get_output_name(), Machine.get() }
+            .run(*Module) ? 0 : 1;
     }
 
     void Parser::fun_stmts() {
@@ -189,6 +259,20 @@ namespace llvmc::parser {
                         fun_def();
                         break;
                     }
+                case Tag{'@'}:
+                    {
+                        move();
+                        auto w = match(Tag::ID);
+                        auto a = static_cast<Word*>(w.get());
+
+                        if(!a || a->lexeme_ != "memo")
+                            LogErrorV("unknown annotation");
+                        else if(!tok_ || *tok_ != Tag::FUN)
+                            LogErrorV("annotation must precede a function");
+                        else
+                            fun_def(true);
+                        break;
+                    }
                 case Tag::ID:
                     {
                         auto call = std::make_unique<ExprStmt>(fun_call());
@@ -217,17 +301,36 @@ namespace llvmc::parser {
         });
     }
 
-    void Parser::fun_def() {
+    void Parser::fun_def(bool memo) {
 
         match(Tag::FUN);
         auto name = match(Tag::ID);
         match(Tag{'('});
 
         ArgList lst{};
+        IndexList ranks{};
+        TypeList elems{};
         while(tok_ && *tok_ != Tag{')'}) {
             
-            if(auto arg = match(Tag::ID))
+            if(auto arg = match(Tag::ID)) {
+
                 lst.emplace_back(std::move(arg));
+                ranks.push_back(0);
+            }
+
+            //A[] or A[][] declares an array parameter of that rank
+            while(tok_ && *tok_ == Tag{'['}) {
+
+                move();
+                match(Tag{']'});
+                if(!ranks.empty()) ++ranks.back();
+            }
+            //only array parameters take an element type, scalars are doubles
+            bool scalar = !ranks.empty() && !ranks.back();
+            if(scalar && tok_ && *tok_ == Tag{':'})
+                LogErrorV("scalar parameter can't have an element type");
+            auto elem = elem_type();
+            if(!ranks.empty()) elems.push_back(scalar ? Builder.getDoubleTy() : elem);
 
             check_end();
             if(*tok_ == Tag{','}) match(Tag{','});
@@ -238,19 +341,25 @@ namespace llvmc::parser {
 
         EnvGuard g{};
         
-        FunStmt fun{ std::move(name), std::move(lst) };
+        FunStmt fun{ std::move(name), std::move(lst),
+            std::move(ranks), std::move(elems) };
 
         match(Tag::IDENT);
         fun.init(stmts());
         match(Tag::DEIDENT);
 
-        fun.compile();
+        auto F = dyn_cast_or_null<Function>(fun.compile());
 
         if(!ret_num_) {
 
             LogErrorV("function must have a return statement");
         }        
         ret_num_ = 0;
+
+        //pure functions are recorded even when not memoized so that
+        //their callers can be recognized as pure too
+        if(F && !err_num_ && !memo::Memoizer{ memo }.run(*F))
+            LogErrorV("@memo function must be pure");
     }
 
     std::unique_ptr<Expr> Parser::fun_call() {
@@ -407,6 +516,9 @@ namespace llvmc::parser {
         else {
 
             IndexList idxs;
+            ArrList dims;
+            uint64_t count = 1;
+            bool fixed{ true };
 
             while(tok_ && *tok_ == Tag{'['}) {
 
@@ -416,24 +528,69 @@ namespace llvmc::parser {
                     move();
                     LogErrorV("array size must be positive number");
                 }
-                double val{0.0};
-                if(auto num = match(Tag::NUM)) {
-                    val = *static_cast<Num const*>(num.get());
-                }
-                else
-                    while(tok_ && *tok_ != Tag{']'}) move();
-                double intp; 
-
-                if(!(std::modf(val, &intp) == 0)) {
 
+                //a literal dimension is known now, anything else at run time
+                dims.emplace_back(pbool());
+                auto num = dynamic_cast<FConstant const*>(dims.back().get());
+                if(num && !num->is_integral())
                     LogErrorV("array size must not be double");
+                else if(num) {
+
+                    double val = *static_cast<Num const*>(num->op_.get());
+                    idxs.emplace_back(static_cast<uint64_t>(val));
+                    count *= idxs.back();
                 }
+                else
+                    fixed = false;
 
-                idxs.emplace_back(static_cast<uint64_t>(intp));
                 match(Tag{']'});
             }
 
-            id = Array::get_array(std::move(name), idxs);
+            auto elem = elem_type();
+            auto bytes = count * layout.getTypeAllocSize(elem);
+
+            //let A[n] mapped "file" [shared] is backed by the file itself
+            auto word = tok_ && *tok_ == Tag::ID
+                ? static_cast<Word const*>(tok_.get()) : nullptr;
+            if(word && word->lexeme_ == "mapped") {
+
+                move();
+                auto path = match(Tag::STR);
+                word = tok_ && *tok_ == Tag::ID
+                    ? static_cast<Word const*>(tok_.get()) : nullptr;
+                bool shared = word && word->lexeme_ == "shared";
+                if(shared) move();
+
+                if(tok_ && *tok_ == Tag{'='})
+                    LogErrorV("mapped array can't have an initializer");
+                if(!path) return nullptr;
+
+                auto arr = MappedArray::get_mapped(std::move(name), elem,
+                    static_cast<Word const*>(path.get())->lexeme_, shared);
+                if(!arr) return nullptr;
+
+                return std::make_unique<ExprStmt>(
+                    std::make_unique<ArrayAlloc>(arr, std::move(dims)));
+            }
+
+            //only small fixed-size arrays stay plain stack objects, and
+            //initialized tables that may be read in place; packed bits
+            //are always addressed through their words
+            bool init = tok_ && *tok_ == Tag{'='};
+            if(fixed && (bytes <= IArray::kStackSize || init) && !elem->isIntegerTy(1))
+                id = Array::get_array(std::move(name), idxs, elem);
+            else {
+
+                auto arr = DynArray::get_dyn(std::move(name), elem);
+                auto alloc = std::make_unique<ArrayAlloc>(arr, std::move(dims));
+
+                if(tok_ && *tok_ == Tag{'='})
+                    LogErrorV(elem->isIntegerTy(1)
+                        ? "bits array can't have an initializer"
+                        : "array of this size can't have an initializer");
+
+                return std::make_unique<ExprStmt>(std::move(alloc));
+            }
         }
 
         if(tok_ && *tok_ != Tag{'='}) return std::make_unique<ExprStmt>(id);
@@ -443,6 +600,26 @@ namespace llvmc::parser {
         return std::make_unique<ExprStmt>(std::move(store));
     }
 
+    Type* Parser::elem_type() {
+
+        if(!tok_ || *tok_ != Tag{':'}) return Builder.getDoubleTy();
+
+        move();
+        auto tok = match(Tag::ID);
+        if(!tok) return Builder.getDoubleTy();
+
+        auto name = static_cast<Word const*>(tok.get())->lexeme_;
+
+        if(name == "i32") return Builder.getInt32Ty();
+        if(name == "i64") return Builder.getInt64Ty();
+        if(name == "f32") return Builder.getFloatTy();
+        if(name == "f64") return Builder.getDoubleTy();
+        if(name == "bits") return Builder.getInt1Ty();
+
+        LogErrorV("unknown element type \'" + name + '\'');
+        return Builder.getDoubleTy();
+    }
+
     std::unique_ptr<inter::Stmt> Parser::assign() {
 
         auto tokName = match(Tag::ID);
@@ -658,7 +835,12 @@ namespace llvmc::parser {
                 ++depth_;
                 check_depth();
                 move();
-                exp = std::make_unique<ArrayConstant>(expr_seq());
+                check_end();
+                //rows are literals themselves, anything else is numbers
+                if(*tok_ == Tag{'['})
+                    exp = std::make_unique<ArrayConstant>(expr_seq());
+                else
+                    exp = std::make_unique<ArrayConstant>(num_seq());
                 match(Tag{']'});
                 --depth_;
                 return exp;
@@ -699,4 +881,58 @@ namespace llvmc::parser {
 
         return lst;
     }
+
+    std::vector<double> Parser::num_seq() {
+
+        //each element is folded to its value as soon as it is parsed,
+        //so a table of any length holds no more than one node at a time
+        std::vector<double> vals{};
+        bool failed = false;
+
+        check_end();
+        if(*tok_ == Tag{']'}) return vals;
+
+        for(bool more = true; more;) {
+
+            //a number on its own, possibly negated, is read straight off
+            //its token; negation is exact, but like integers -0 is 0
+            auto minus = tok_ && *tok_ == Tag{'-'} ? std::move(tok_) : nullptr;
+            if(minus) move();
+
+            if(tok_ && *tok_ == Tag::NUM) {
+
+                auto num = std::move(tok_);
+                move();
+
+                if(!tok_ || *tok_ == Tag{','} || *tok_ == Tag{']'}) {
+
+                    double v = *static_cast<Num const*>(num.get());
+                    vals.push_back(minus ? 0 - v : v);
+
+                    more = tok_ && *tok_ == Tag{','};
+                    if(more) move();
+                    continue;
+                }
+                unget(std::move(num));
+            }
+            if(minus) unget(std::move(minus));
+
+            auto el = pbool();
+            auto A = dynamic_cast<IArray const*>(el.get());
+            auto V = el && !A ? el->compile() : nullptr;
+            auto C = V ? dyn_cast<ConstantFP>(Expr::to_double(V)) : nullptr;
+
+            if(C)
+                vals.push_back(C->getValueAPF().convertToDouble());
+            else if(!failed && (A || V))
+                LogErrorV(A ? "invalid constant initializer"
+                    : "constant array has non-constant initializer");
+            failed |= !C;
+
+            more = tok_ && *tok_ == Tag{','};
+            if(more) move();
+        }
+
+        return vals;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include <llvmc/ireduce.h>
+#include <llvmc/inames.h>
+#include <limits>
+#include <unordered_map>
+
+namespace llvmc::reduce {
+
+    using namespace llvm;
+
+    Reducer::Reducer(Kind k) noexcept : kind_{ k } {}
+
+    std::optional<Kind> Reducer::get_kind(std::string const& name) {
+
+        static const std::unordered_map<std::string, Kind> kinds{
+            { "sum", Kind::Sum }, { "min", Kind::Min }, { "max", Kind::Max },
+            { "argmin", Kind::ArgMin }, { "argmax", Kind::ArgMax },
+            { "dot", Kind::Dot } };
+
+        if(auto it = kinds.find(name); it != kinds.end()) return it->second;
+
+        return std::nullopt;
+    }
+    size_t Reducer::get_arity(Kind k) {
+
+        return k == Kind::Dot ? 2 : 1;
+    }
+
+    Value* Reducer::convert(IRBuilder<>& B, Value* V, Type* T) {
+
+        if(V->getType() == T) return V;
+        if(T->getScalarType()->isIntegerTy()) return B.CreateSExtOrTrunc(V, T);
+        if(V->getType()->getScalarType()->isIntegerTy()) return B.CreateSIToFP(V, T);
+
+        return B.CreateFPExt(V, T);
+    }
+    bool Reducer::is_arg() const {
+
+        return kind_ == Kind::ArgMin || kind_ == Kind::ArgMax;
+    }
+    bool Reducer::is_min() const {
+
+        return kind_ == Kind::Min || kind_ == Kind::ArgMin;
+    }
+    Type* Reducer::acc_type(IRBuilder<>& B, SmallVectorImpl<Type*> const& elems) const {
+
+        //integers are accumulated exactly, anything else in double
+        for(auto E : elems)
+            if(!E->isIntegerTy()) return B.getDoubleTy();
+
+        return B.getInt64Ty();
+    }
+    Value* Reducer::emit_identity(IRBuilder<>& B, Type* T) const {
+
+        if(kind_ == Kind::Sum || kind_ == Kind::Dot)
+            return Constant::getNullValue(T);
+
+        if(T->isIntegerTy())
+            return is_min() ? B.getInt64(std::numeric_limits<int64_t>::max())
+                : B.getInt64(std::numeric_limits<int64_t>::min());
+
+        return ConstantFP::getInfinity(T, !is_min());
+    }
+    Value* Reducer::emit_better(IRBuilder<>& B, Value* X, Value* Acc) const {
+
+        //strict comparisons keep the first of equal elements
+        if(X->getType()->getScalarType()->isIntegerTy())
+            return is_min() ? B.CreateICmpSLT(X, Acc) : B.CreateICmpSGT(X, Acc);
+
+        return is_min() ? B.CreateFCmpOLT(X, Acc) : B.CreateFCmpOGT(X, Acc);
+    }
+    Value* Reducer::emit_step(IRBuilder<>& B, Value* Acc, Value* X, Value* Y) const {
+
+        bool integral = X->getType()->getScalarType()->isIntegerTy();
+
+        if(kind_ == Kind::Min || kind_ == Kind::Max)
+            return B.CreateSelect(emit_better(B, X, Acc), X, Acc);
+
+        if(Y) X = integral ? B.CreateMul(X, Y) : B.CreateFMul(X, Y);
+
+        return integral ? B.CreateAdd(Acc, X) : B.CreateFAdd(Acc, X);
+    }
+    Value* Reducer::emit_fold(IRBuilder<>& B, Value* V) const {
+
+        bool integral = V->getType()->getScalarType()->isIntegerTy();
+
+        if(kind_ == Kind::Sum || kind_ == Kind::Dot) {
+
+            if(integral) return B.CreateAddReduce(V);
+
+            //the accumulators already reassociate the sum
+            FastMathFlags FMF;
+            FMF.setAllowReassoc();
+            IRBuilder<>::FastMathFlagGuard g{ B };
+            B.setFastMathFlags(FMF);
+
+            return B.CreateFAddReduce(ConstantFP::get(
+                V->getType()->getScalarType(), 0.0), V);
+        }
+
+        if(integral)
+            return is_min() ? B.CreateIntMinReduce(V, true)
+                : B.CreateIntMaxReduce(V, true);
+
+        return is_min() ? B.CreateFPMinReduce(V) : B.CreateFPMaxReduce(V);
+    }
+    void Reducer::emit_body(Function& F, SmallVectorImpl<Type*> const& elems) const {
+
+        auto& C = F.getContext();
+        auto& DL = F.getParent()->getDataLayout();
+        IRBuilder<> B{ BasicBlock::Create(C, "", &F) };
+
+        auto I64 = B.getInt64Ty();
+        auto T = acc_type(B, elems);
+        auto VT = FixedVectorType::get(T, lanes_);
+        unsigned unroll = is_arg() ? 1 : unroll_;
+        uint64_t step = lanes_ * unroll;
+        auto N = F.getArg(elems.size());
+
+        auto load = [&](size_t a, Value* Off, Type* To) {
+
+            auto E = elems[a];
+            Value* P = B.CreateGEP(E, F.getArg(a), Off);
+            if(!To->isVectorTy())
+                return convert(B, B.CreateAlignedLoad(E, P, DL.getABITypeAlign(E)), To);
+
+            auto VE = FixedVectorType::get(E, lanes_);
+            P = B.CreatePointerCast(P, PointerType::getUnqual(VE));
+
+            return convert(B, B.CreateAlignedLoad(VE, P, DL.getABITypeAlign(E)), To);
+        };
+
+        auto EntryBB = B.GetInsertBlock();
+        auto VHeadBB = BasicBlock::Create(C, "", &F);
+        auto VBodyBB = BasicBlock::Create(C, "", &F);
+        auto VDoneBB = BasicBlock::Create(C, "", &F);
+        auto SHeadBB = BasicBlock::Create(C, "", &F);
+        auto SBodyBB = BasicBlock::Create(C, "", &F);
+        auto DoneBB = BasicBlock::Create(C, "", &F);
+
+        //whole blocks of elements go through the vector loop, where
+        //independent accumulators break the dependency chain
+        auto Main = B.CreateAnd(N, B.getInt64(~(step - 1)));
+        auto Id = B.CreateVectorSplat(lanes_, emit_identity(B, T));
+        SmallVector<Constant*, 8> lanes;
+        for(unsigned l = 0; l < lanes_; l++) lanes.push_back(B.getInt64(l));
+        auto Lanes = ConstantVector::get(lanes);
+        B.CreateBr(VHeadBB);
+
+        B.SetInsertPoint(VHeadBB);
+        auto I = B.CreatePHI(I64, 2);
+        I->addIncoming(B.getInt64(0), EntryBB);
+        SmallVector<PHINode*, 8> accs, idxs;
+        for(unsigned u = 0; u < unroll; u++) {
+
+            accs.push_back(B.CreatePHI(VT, 2));
+            accs.back()->addIncoming(Id, EntryBB);
+
+            if(!is_arg()) continue;
+
+            idxs.push_back(B.CreatePHI(Lanes->getType(), 2));
+            idxs.back()->addIncoming(Constant::getNullValue(Lanes->getType()), EntryBB);
+        }
+        B.CreateCondBr(B.CreateICmpULT(I, Main), VBodyBB, VDoneBB);
+
+        B.SetInsertPoint(VBodyBB);
+        for(unsigned u = 0; u < unroll; u++) {
+
+            auto Off = B.CreateAdd(I, B.getInt64(u * lanes_));
+            auto X = load(0, Off, VT);
+            auto Y = kind_ == Kind::Dot ? load(1, Off, VT) : nullptr;
+
+            if(is_arg()) {
+
+                auto Better = emit_better(B, X, accs[u]);
+                auto Lane = B.CreateAdd(B.CreateVectorSplat(lanes_, Off), Lanes);
+                idxs[u]->addIncoming(B.CreateSelect(Better, Lane, idxs[u]), VBodyBB);
+                accs[u]->addIncoming(B.CreateSelect(Better, X, accs[u]), VBodyBB);
+            }
+            else
+                accs[u]->addIncoming(emit_step(B, accs[u], X, Y), VBodyBB);
+        }
+        I->addIncoming(B.CreateAdd(I, B.getInt64(step)), VBodyBB);
+        B.CreateBr(VHeadBB);
+
+        B.SetInsertPoint(VDoneBB);
+        Value* V = accs[0];
+        for(unsigned u = 1; u < unroll; u++)
+            V = emit_step(B, V, accs[u], nullptr);
+        Value* S = emit_fold(B, V);
+        Value* Idx = nullptr;
+        if(is_arg()) {
+
+            //of the lanes holding the best value, the lowest index wins
+            auto Splat = B.CreateVectorSplat(lanes_, S);
+            auto Hit = T->isIntegerTy() ? B.CreateICmpEQ(V, Splat)
+                : B.CreateFCmpOEQ(V, Splat);
+            Idx = B.CreateIntMinReduce(B.CreateSelect(Hit, idxs[0],
+                B.CreateVectorSplat(lanes_, B.getInt64(~0ull))), false);
+        }
+        B.CreateBr(SHeadBB);
+
+        //the remaining elements one at a time
+        B.SetInsertPoint(SHeadBB);
+        auto J = B.CreatePHI(I64, 2);
+        J->addIncoming(Main, VDoneBB);
+        auto Acc = B.CreatePHI(T, 2);
+        Acc->addIncoming(S, VDoneBB);
+        PHINode* Best = nullptr;
+        if(is_arg()) {
+
+            Best = B.CreatePHI(I64, 2);
+            Best->addIncoming(Idx, VDoneBB);
+        }
+        B.CreateCondBr(B.CreateICmpULT(J, N), SBodyBB, DoneBB);
+
+        B.SetInsertPoint(SBodyBB);
+        auto X = load(0, J, T);
+        auto Y = kind_ == Kind::Dot ? load(1, J, T) : nullptr;
+        if(is_arg()) {
+
+            auto Better = emit_better(B, X, Acc);
+            Best->addIncoming(B.CreateSelect(Better, J, Best), SBodyBB);
+            Acc->addIncoming(B.CreateSelect(Better, X, Acc), SBodyBB);
+        }
+        else
+            Acc->addIncoming(emit_step(B, Acc, X, Y), SBodyBB);
+        J->addIncoming(B.CreateAdd(J, B.getInt64(1)), SBodyBB);
+        B.CreateBr(SHeadBB);
+
+        //an empty array has no extremum and no position of one
+        B.SetInsertPoint(DoneBB);
+        auto Empty = B.CreateICmpEQ(N, B.getInt64(0));
+        Value* R = nullptr;
+        if(is_arg())
+            R = B.CreateSelect(Empty, ConstantFP::get(B.getDoubleTy(), -1.0),
+                B.CreateUIToFP(Best, B.getDoubleTy()));
+        else {
+
+            R = convert(B, Acc, B.getDoubleTy());
+            if(kind_ == Kind::Min || kind_ == Kind::Max)
+                R = B.CreateSelect(Empty, ConstantFP::getNaN(B.getDoubleTy()), R);
+        }
+        B.CreateRet(R);
+    }
+
+    Function* Reducer::get(Module& M, SmallVectorImpl<Type*> const& elems) const {
+
+        std::string name = "llvmc.";
+        switch(kind_) {
+
+            case Kind::Sum: name += "sum"; break;
+            case Kind::Min: name += "min"; break;
+            case Kind::Max: name += "max"; break;
+            case Kind::ArgMin: name += "argmin"; break;
+            case Kind::ArgMax: name += "argmax"; break;
+            case Kind::Dot: name += "dot"; break;
+        }
+        for(auto E : elems) {
+
+            name += '.';
+            names::append_type(name, E);
+        }
+
+        //one instance per combination of element types
+        if(auto F = M.getFunction(name)) return F;
+
+        SmallVector<Type*, 4> params;
+        for(auto E : elems) params.push_back(PointerType::getUnqual(E));
+        params.push_back(Type::getInt64Ty(M.getContext()));
+
+        auto F = Function::Create(FunctionType::get(
+            Type::getDoubleTy(M.getContext()), params, false),
+            Function::ExternalLinkage, name, &M);
+        emit_body(*F, elems);
+
+        return F;
+    }
+}
\ No newline at end of file
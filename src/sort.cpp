@@ -0,0 +1,344 @@
+#include <llvmc/isort.h>
+#include <llvmc/inames.h>
+
+namespace llvmc::sort {
+
+    using namespace llvm;
+
+    Sorter::Sorter(Type* E) : elem_{ E } {
+
+        names::append_type(name_, E);
+    }
+
+    Value* Sorter::emit_at(IRBuilder<>& B, Value* P, Value* I) const {
+
+        return B.CreateGEP(elem_, P, I);
+    }
+    Value* Sorter::emit_less(IRBuilder<>& B, Value* L, Value* R) const {
+
+        //NaNs compare false both ways, which the partition tolerates
+        if(elem_->isIntegerTy()) return B.CreateICmpSLT(L, R);
+
+        return B.CreateFCmpOLT(L, R);
+    }
+    void Sorter::emit_swap(IRBuilder<>& B, Value* L, Value* R) const {
+
+        auto X = B.CreateLoad(elem_, L);
+        auto Y = B.CreateLoad(elem_, R);
+        B.CreateStore(Y, L);
+        B.CreateStore(X, R);
+    }
+    Function* Sorter::create(Module& M, std::string const& suffix,
+        ArrayRef<Type*> params) const {
+
+        auto F = Function::Create(FunctionType::get(Type::getVoidTy(M.getContext()),
+            params, false), Function::InternalLinkage,
+            "llvmc.sort." + name_ + suffix, &M);
+        F->addFnAttr(Attribute::NoUnwind);
+
+        return F;
+    }
+
+    Function* Sorter::emit_insertion(Module& M) const {
+
+        auto& C = M.getContext();
+        auto I64 = Type::getInt64Ty(C);
+        auto F = create(M, ".small", { PointerType::getUnqual(elem_), I64, I64 });
+        auto P = F->getArg(0), Lo = F->getArg(1), Hi = F->getArg(2);
+
+        auto EntryBB = BasicBlock::Create(C, "", F);
+        auto OuterBB = BasicBlock::Create(C, "", F);
+        auto BodyBB = BasicBlock::Create(C, "", F);
+        auto InnerBB = BasicBlock::Create(C, "", F);
+        auto ShiftBB = BasicBlock::Create(C, "", F);
+        auto PlaceBB = BasicBlock::Create(C, "", F);
+        auto DoneBB = BasicBlock::Create(C, "", F);
+        IRBuilder<> B{ EntryBB };
+        auto First = B.CreateAdd(Lo, B.getInt64(1));
+        B.CreateBr(OuterBB);
+
+        B.SetInsertPoint(OuterBB);
+        auto K = B.CreatePHI(I64, 2);
+        K->addIncoming(First, EntryBB);
+        B.CreateCondBr(B.CreateICmpSLT(K, Hi), BodyBB, DoneBB);
+
+        B.SetInsertPoint(BodyBB);
+        auto X = B.CreateLoad(elem_, emit_at(B, P, K));
+        B.CreateBr(InnerBB);
+
+        //shift larger elements right until x's place is found
+        B.SetInsertPoint(InnerBB);
+        auto J = B.CreatePHI(I64, 2);
+        J->addIncoming(K, BodyBB);
+        auto J1 = B.CreateSub(J, B.getInt64(1));
+        auto InRange = B.CreateICmpSGT(J, Lo);
+        auto Prev = B.CreateLoad(elem_, emit_at(B, P, B.CreateSelect(InRange, J1, J)));
+        B.CreateCondBr(B.CreateAnd(InRange, emit_less(B, X, Prev)), ShiftBB, PlaceBB);
+
+        B.SetInsertPoint(ShiftBB);
+        B.CreateStore(Prev, emit_at(B, P, J));
+        J->addIncoming(J1, ShiftBB);
+        B.CreateBr(InnerBB);
+
+        B.SetInsertPoint(PlaceBB);
+        B.CreateStore(X, emit_at(B, P, J));
+        K->addIncoming(B.CreateAdd(K, B.getInt64(1)), PlaceBB);
+        B.CreateBr(OuterBB);
+
+        B.SetInsertPoint(DoneBB);
+        B.CreateRetVoid();
+
+        return F;
+    }
+    Function* Sorter::emit_sift(Module& M) const {
+
+        auto& C = M.getContext();
+        auto I64 = Type::getInt64Ty(C);
+        auto F = create(M, ".sift", { PointerType::getUnqual(elem_), I64, I64 });
+        auto P = F->getArg(0), Root = F->getArg(1), N = F->getArg(2);
+
+        auto EntryBB = BasicBlock::Create(C, "", F);
+        auto HeadBB = BasicBlock::Create(C, "", F);
+        auto PickBB = BasicBlock::Create(C, "", F);
+        auto SwapBB = BasicBlock::Create(C, "", F);
+        auto DoneBB = BasicBlock::Create(C, "", F);
+        IRBuilder<> B{ EntryBB };
+        B.CreateBr(HeadBB);
+
+        B.SetInsertPoint(HeadBB);
+        auto R = B.CreatePHI(I64, 2);
+        R->addIncoming(Root, EntryBB);
+        auto Child = B.CreateAdd(B.CreateShl(R, 1), B.getInt64(1));
+        B.CreateCondBr(B.CreateICmpSLT(Child, N), PickBB, DoneBB);
+
+        //move the root below its larger child while that child is larger
+        B.SetInsertPoint(PickBB);
+        auto Right = B.CreateAdd(Child, B.getInt64(1));
+        auto HasRight = B.CreateICmpSLT(Right, N);
+        auto L = B.CreateLoad(elem_, emit_at(B, P, Child));
+        auto RV = B.CreateLoad(elem_, emit_at(B, P, B.CreateSelect(HasRight, Right, Child)));
+        auto Big = B.CreateSelect(B.CreateAnd(HasRight, emit_less(B, L, RV)), Right, Child);
+        auto RootPtr = emit_at(B, P, R);
+        auto BigPtr = emit_at(B, P, Big);
+        B.CreateCondBr(emit_less(B, B.CreateLoad(elem_, RootPtr),
+            B.CreateLoad(elem_, BigPtr)), SwapBB, DoneBB);
+
+        B.SetInsertPoint(SwapBB);
+        emit_swap(B, RootPtr, BigPtr);
+        R->addIncoming(Big, SwapBB);
+        B.CreateBr(HeadBB);
+
+        B.SetInsertPoint(DoneBB);
+        B.CreateRetVoid();
+
+        return F;
+    }
+    Function* Sorter::emit_heap(Module& M, Function* Sift) const {
+
+        auto& C = M.getContext();
+        auto I64 = Type::getInt64Ty(C);
+        auto F = create(M, ".heap", { PointerType::getUnqual(elem_), I64, I64 });
+
+        auto EntryBB = BasicBlock::Create(C, "", F);
+        auto BuildBB = BasicBlock::Create(C, "", F);
+        auto SiftBB = BasicBlock::Create(C, "", F);
+        auto PopBB = BasicBlock::Create(C, "", F);
+        auto TakeBB = BasicBlock::Create(C, "", F);
+        auto DoneBB = BasicBlock::Create(C, "", F);
+        IRBuilder<> B{ EntryBB };
+        auto P = emit_at(B, F->getArg(0), F->getArg(1));
+        auto N = B.CreateSub(F->getArg(2), F->getArg(1));
+        auto Half = B.CreateAShr(N, 1);
+        B.CreateBr(BuildBB);
+
+        B.SetInsertPoint(BuildBB);
+        auto S = B.CreatePHI(I64, 2);
+        S->addIncoming(Half, EntryBB);
+        B.CreateCondBr(B.CreateICmpSGT(S, B.getInt64(0)), SiftBB, PopBB);
+
+        B.SetInsertPoint(SiftBB);
+        auto S1 = B.CreateSub(S, B.getInt64(1));
+        B.CreateCall(Sift, { P, S1, N });
+        S->addIncoming(S1, SiftBB);
+        B.CreateBr(BuildBB);
+
+        //repeatedly move the maximum behind the shrinking heap
+        B.SetInsertPoint(PopBB);
+        auto End = B.CreatePHI(I64, 2);
+        End->addIncoming(N, BuildBB);
+        B.CreateCondBr(B.CreateICmpSGT(End, B.getInt64(1)), TakeBB, DoneBB);
+
+        B.SetInsertPoint(TakeBB);
+        auto E1 = B.CreateSub(End, B.getInt64(1));
+        emit_swap(B, P, emit_at(B, P, E1));
+        B.CreateCall(Sift, { P, B.getInt64(0), E1 });
+        End->addIncoming(E1, TakeBB);
+        B.CreateBr(PopBB);
+
+        B.SetInsertPoint(DoneBB);
+        B.CreateRetVoid();
+
+        return F;
+    }
+    Function* Sorter::emit_intro(Module& M) const {
+
+        auto& C = M.getContext();
+        auto I64 = Type::getInt64Ty(C);
+        auto Small = emit_insertion(M);
+        auto Heap = emit_heap(M, emit_sift(M));
+        auto F = create(M, ".intro", { PointerType::getUnqual(elem_), I64, I64, I64 });
+        auto P = F->getArg(0);
+
+        auto EntryBB = BasicBlock::Create(C, "", F);
+        auto HeadBB = BasicBlock::Create(C, "", F);
+        auto DepthBB = BasicBlock::Create(C, "", F);
+        auto SmallBB = BasicBlock::Create(C, "", F);
+        auto HeapBB = BasicBlock::Create(C, "", F);
+        auto PartBB = BasicBlock::Create(C, "", F);
+        auto ScanBB = BasicBlock::Create(C, "", F);
+        auto ScanIBB = BasicBlock::Create(C, "", F);
+        auto ScanJBB = BasicBlock::Create(C, "", F);
+        auto CrossBB = BasicBlock::Create(C, "", F);
+        auto SwapBB = BasicBlock::Create(C, "", F);
+        auto SplitBB = BasicBlock::Create(C, "", F);
+        IRBuilder<> B{ EntryBB };
+        B.CreateBr(HeadBB);
+
+        //the larger side is iterated on, the smaller one recursed into,
+        //so the stack stays logarithmic
+        B.SetInsertPoint(HeadBB);
+        auto Lo = B.CreatePHI(I64, 2);
+        auto Hi = B.CreatePHI(I64, 2);
+        auto Depth = B.CreatePHI(I64, 2);
+        Lo->addIncoming(F->getArg(1), EntryBB);
+        Hi->addIncoming(F->getArg(2), EntryBB);
+        Depth->addIncoming(F->getArg(3), EntryBB);
+        auto Len = B.CreateSub(Hi, Lo);
+        B.CreateCondBr(B.CreateICmpSLE(Len, B.getInt64(small_size_)), SmallBB, DepthBB);
+
+        B.SetInsertPoint(SmallBB);
+        B.CreateCall(Small, { P, Lo, Hi });
+        B.CreateRetVoid();
+
+        //too many bad pivots: finish in guaranteed n log n
+        B.SetInsertPoint(DepthBB);
+        B.CreateCondBr(B.CreateICmpEQ(Depth, B.getInt64(0)), HeapBB, PartBB);
+
+        B.SetInsertPoint(HeapBB);
+        B.CreateCall(Heap, { P, Lo, Hi });
+        B.CreateRetVoid();
+
+        //median of three; afterwards P[lo] <= pivot <= P[hi - 1] bound both scans
+        B.SetInsertPoint(PartBB);
+        auto First = emit_at(B, P, Lo);
+        auto Mid = emit_at(B, P, B.CreateAdd(Lo, B.CreateLShr(Len, 1)));
+        auto Last = emit_at(B, P, B.CreateSub(Hi, B.getInt64(1)));
+        auto order = [&](Value* L, Value* R) {
+
+            auto X = B.CreateLoad(elem_, L);
+            auto Y = B.CreateLoad(elem_, R);
+            auto Swap = emit_less(B, Y, X);
+            B.CreateStore(B.CreateSelect(Swap, Y, X), L);
+            B.CreateStore(B.CreateSelect(Swap, X, Y), R);
+        };
+        order(First, Mid);
+        order(Mid, Last);
+        order(First, Mid);
+        auto PivotIdx = B.CreateSub(Hi, B.getInt64(2));
+        auto PivotPtr = emit_at(B, P, PivotIdx);
+        emit_swap(B, Mid, PivotPtr);
+        auto Pivot = B.CreateLoad(elem_, PivotPtr);
+        B.CreateBr(ScanBB);
+
+        B.SetInsertPoint(ScanBB);
+        auto I = B.CreatePHI(I64, 2);
+        auto J = B.CreatePHI(I64, 2);
+        I->addIncoming(Lo, PartBB);
+        J->addIncoming(PivotIdx, PartBB);
+        B.CreateBr(ScanIBB);
+
+        B.SetInsertPoint(ScanIBB);
+        auto II = B.CreatePHI(I64, 2);
+        II->addIncoming(I, ScanBB);
+        auto I1 = B.CreateAdd(II, B.getInt64(1));
+        II->addIncoming(I1, ScanIBB);
+        B.CreateCondBr(emit_less(B, B.CreateLoad(elem_, emit_at(B, P, I1)), Pivot),
+            ScanIBB, ScanJBB);
+
+        B.SetInsertPoint(ScanJBB);
+        auto JJ = B.CreatePHI(I64, 2);
+        JJ->addIncoming(J, ScanIBB);
+        auto J1 = B.CreateSub(JJ, B.getInt64(1));
+        JJ->addIncoming(J1, ScanJBB);
+        B.CreateCondBr(emit_less(B, Pivot, B.CreateLoad(elem_, emit_at(B, P, J1))),
+            ScanJBB, CrossBB);
+
+        B.SetInsertPoint(CrossBB);
+        auto IPtr = emit_at(B, P, I1);
+        B.CreateCondBr(B.CreateICmpSGE(I1, J1), SplitBB, SwapBB);
+
+        B.SetInsertPoint(SwapBB);
+        emit_swap(B, IPtr, emit_at(B, P, J1));
+        I->addIncoming(I1, SwapBB);
+        J->addIncoming(J1, SwapBB);
+        B.CreateBr(ScanBB);
+
+        //the pivot lands at i, between the two sides
+        B.SetInsertPoint(SplitBB);
+        emit_swap(B, IPtr, PivotPtr);
+        auto D1 = B.CreateSub(Depth, B.getInt64(1));
+        auto LeftSmaller = B.CreateICmpSLT(B.CreateSub(I1, Lo),
+            B.CreateSub(Hi, I1));
+        auto After = B.CreateAdd(I1, B.getInt64(1));
+        auto RecLo = B.CreateSelect(LeftSmaller, Lo, After);
+        auto RecHi = B.CreateSelect(LeftSmaller, I1, Hi);
+        B.CreateCall(F, { P, RecLo, RecHi, D1 });
+        Lo->addIncoming(B.CreateSelect(LeftSmaller, After, Lo), SplitBB);
+        Hi->addIncoming(B.CreateSelect(LeftSmaller, Hi, I1), SplitBB);
+        Depth->addIncoming(D1, SplitBB);
+        B.CreateBr(HeadBB);
+
+        return F;
+    }
+
+    Function* Sorter::get(Module& M) const {
+
+        auto name = "llvmc.sort." + name_;
+        if(auto F = M.getFunction(name)) return F;
+
+        auto& C = M.getContext();
+        auto I64 = Type::getInt64Ty(C);
+        auto Intro = emit_intro(M);
+
+        //sort(P, n, lo, hi) orders P[lo..hi) after clamping it to the array
+        auto F = Function::Create(FunctionType::get(Type::getDoubleTy(C),
+            { PointerType::getUnqual(elem_), I64, I64, I64 }, false),
+            Function::ExternalLinkage, name, &M);
+        auto P = F->getArg(0), N = F->getArg(1);
+
+        auto EntryBB = BasicBlock::Create(C, "", F);
+        auto SortBB = BasicBlock::Create(C, "", F);
+        auto DoneBB = BasicBlock::Create(C, "", F);
+        IRBuilder<> B{ EntryBB };
+        auto clamp = [&](Value* V, Value* Max) {
+
+            V = B.CreateSelect(B.CreateICmpSLT(V, Max), V, Max);
+            return B.CreateSelect(B.CreateICmpSGT(V, B.getInt64(0)), V, B.getInt64(0));
+        };
+        auto Hi = clamp(F->getArg(3), N);
+        auto Lo = clamp(F->getArg(2), Hi);
+        B.CreateCondBr(B.CreateICmpULT(Lo, Hi), SortBB, DoneBB);
+
+        //depth budget of 2 log2(n) partitions, as in introsort
+        B.SetInsertPoint(SortBB);
+        auto Log = B.CreateSub(B.getInt64(63), B.CreateBinaryIntrinsic(Intrinsic::ctlz,
+            B.CreateOr(B.CreateSub(Hi, Lo), B.getInt64(1)), B.getFalse()));
+        B.CreateCall(Intro, { P, Lo, Hi, B.CreateShl(Log, 1) });
+        B.CreateBr(DoneBB);
+
+        B.SetInsertPoint(DoneBB);
+        B.CreateRet(ConstantFP::get(B.getDoubleTy(), 0.0));
+
+        return F;
+    }
+}
\ No newline at end of file